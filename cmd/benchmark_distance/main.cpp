@@ -0,0 +1,357 @@
+#include <Discregrid/All>
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+using namespace Eigen;
+
+std::istream& operator>>(std::istream& is, std::array<unsigned int, 3>& data)
+{
+	is >> data[0] >> data[1] >> data[2];
+	return is;
+}
+
+#include <cxxopts/cxxopts.hpp>
+
+namespace
+{
+
+// Sample points of a cubic Lagrange grid, grouped into tiles of 8^3 grid vertices as sampled by
+// CubicLagrangeDiscreteGrid::addFunction. The points of tile t are [offsets[t], offsets[t + 1]).
+struct SamplePoints
+{
+	std::vector<float> x, y, z;
+	std::vector<std::size_t> offsets;
+};
+
+std::uint64_t interleave(unsigned int v)
+{
+	auto x = static_cast<std::uint64_t>(v) & 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffff;
+	x = (x | x << 16) & 0x1f0000ff0000ff;
+	x = (x | x << 8) & 0x100f00f00f00f00f;
+	x = (x | x << 4) & 0x10c30c30c30c30c3;
+	x = (x | x << 2) & 0x1249249249249249;
+	return x;
+}
+
+// Generates the vertex and edge nodes of a grid with the given resolution tile by tile along a
+// z-curve. Only a random subset of the tiles of the given fraction is kept.
+SamplePoints gridSamplePoints(AlignedBox3f const& domain, std::array<unsigned int, 3> const& resolution,
+	float fraction, unsigned int seed)
+{
+	auto const tile_size = 8u;
+	auto cell_size = (domain.diagonal().array() / Array3f(static_cast<float>(resolution[0]),
+		static_cast<float>(resolution[1]), static_cast<float>(resolution[2]))).matrix().eval();
+
+	auto n_tiles = std::array<unsigned int, 3>{};
+	for (auto d = 0u; d < 3u; ++d)
+		n_tiles[d] = resolution[d] / tile_size + 1u;
+	auto tiles = std::vector<std::pair<std::uint64_t, unsigned int>>{};
+	auto gen = std::mt19937(seed);
+	auto u = std::uniform_real_distribution<float>(0.0f, 1.0f);
+	for (auto t = 0u; t < n_tiles[0] * n_tiles[1] * n_tiles[2]; ++t)
+	{
+		auto ti = t % n_tiles[0], tj = t / n_tiles[0] % n_tiles[1], tk = t / (n_tiles[0] * n_tiles[1]);
+		if (u(gen) < fraction)
+			tiles.push_back({interleave(ti) | interleave(tj) << 1 | interleave(tk) << 2, t});
+	}
+	std::sort(tiles.begin(), tiles.end());
+
+	auto p = SamplePoints{};
+	p.offsets.push_back(0u);
+	for (auto const& tile : tiles)
+	{
+		auto t = tile.second;
+		auto lo = std::array<unsigned int, 3>{{tile_size * (t % n_tiles[0]),
+			tile_size * (t / n_tiles[0] % n_tiles[1]), tile_size * (t / (n_tiles[0] * n_tiles[1]))}};
+		auto hi = std::array<unsigned int, 3>{};
+		for (auto d = 0u; d < 3u; ++d)
+			hi[d] = std::min(lo[d] + tile_size, resolution[d] + 1u);
+
+		for (auto k = lo[2]; k < hi[2]; ++k)
+			for (auto j = lo[1]; j < hi[1]; ++j)
+				for (auto i = lo[0]; i < hi[0]; ++i)
+				{
+					auto ijk = std::array<unsigned int, 3>{{i, j, k}};
+					auto xv = (domain.min() + cell_size.cwiseProduct(Vector3f(
+						static_cast<float>(i), static_cast<float>(j), static_cast<float>(k)))).eval();
+					p.x.push_back(xv[0]);
+					p.y.push_back(xv[1]);
+					p.z.push_back(xv[2]);
+					for (auto d = 0u; d < 3u; ++d)
+					{
+						if (ijk[d] == resolution[d])
+							continue;
+						for (auto s = 1u; s <= 2u; ++s)
+						{
+							auto x = xv;
+							x[d] += static_cast<float>(s) / 3.0f * cell_size[d];
+							p.x.push_back(x[0]);
+							p.y.push_back(x[1]);
+							p.z.push_back(x[2]);
+						}
+					}
+				}
+		p.offsets.push_back(p.x.size());
+	}
+	return p;
+}
+
+// Splits every triangle into four at its edge midpoints, which yields large meshes of the same
+// shape for benchmarking.
+void subdivide(std::vector<Vector3f>& vertices, std::vector<std::array<unsigned int, 3>>& faces)
+{
+	auto midpoints = std::unordered_map<std::uint64_t, unsigned int>{};
+	auto midpoint = [&](unsigned int a, unsigned int b)
+	{
+		auto key = static_cast<std::uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+		auto it = midpoints.find(key);
+		if (it != midpoints.end())
+			return it->second;
+		vertices.push_back(0.5f * (vertices[a] + vertices[b]));
+		return midpoints[key] = static_cast<unsigned int>(vertices.size() - 1u);
+	};
+
+	auto subdivided = std::vector<std::array<unsigned int, 3>>{};
+	subdivided.reserve(4u * faces.size());
+	for (auto const& f : faces)
+	{
+		auto m01 = midpoint(f[0], f[1]), m12 = midpoint(f[1], f[2]), m20 = midpoint(f[2], f[0]);
+		subdivided.push_back({{f[0], m01, m20}});
+		subdivided.push_back({{m01, f[1], m12}});
+		subdivided.push_back({{m20, m12, f[2]}});
+		subdivided.push_back({{m01, m12, m20}});
+	}
+	faces.swap(subdivided);
+}
+
+// Runs f once and returns the wall time in seconds.
+template <typename F>
+double timed(F const& f)
+{
+	using namespace std::chrono;
+	auto t0 = high_resolution_clock::now();
+	f();
+	auto t1 = high_resolution_clock::now();
+	return duration<double>(t1 - t0).count();
+}
+
+// Returns the time to build a hierarchy of the given type over the faces of the mesh.
+template <typename Hierarchy>
+double buildTime(Discregrid::TriangleMesh const& mesh, Discregrid::SplitStrategy split_strategy, unsigned int leaf_size)
+{
+	Hierarchy hierarchy(mesh.vertex_data(), mesh.face_data());
+	hierarchy.setSplitStrategy(split_strategy);
+	hierarchy.setMaxLeafSize(leaf_size);
+	return timed([&]() { hierarchy.construct(); });
+}
+
+void report(std::string const& name, std::size_t n, double seconds, double reference)
+{
+	std::cout << "\t" << std::left << std::setw(20) << name << std::right
+		<< std::setw(12) << std::fixed << std::setprecision(1) << 1.0e-3 * static_cast<double>(n) / seconds << " kqueries/s"
+		<< std::setw(12) << std::setprecision(3) << seconds << " s"
+		<< std::setw(10) << std::setprecision(2) << reference / seconds << "x" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	cxxopts::Options options(argv[0], "Measures the throughput of mesh distance queries at the nodes of a cubic Lagrange grid.");
+	options.positional_help("[input OBJ file]");
+
+	options.add_options()
+	("h,help", "Prints this help text")
+	("r,resolution", "Grid resolution", cxxopts::value<std::array<unsigned int, 3>>()->default_value("128 128 128"))
+	("fraction", "Fraction of the tiles of 8^3 grid vertices that are sampled", cxxopts::value<float>()->default_value("1"))
+	("margin", "Enlargement of the grid domain beyond the mesh bounding box relative to its diagonal", cxxopts::value<float>()->default_value("0.001"))
+	("seed", "Seed of the random tile selection", cxxopts::value<unsigned int>()->default_value("0"))
+	("subdivide", "Number of times each triangle is split into four before the benchmark", cxxopts::value<unsigned int>()->default_value("0"))
+	("hull", "Bounding volumes of the hierarchy (sphere or box)", cxxopts::value<std::string>()->default_value("sphere"))
+	("split", "Split strategy of the hierarchy (median, sah or volume)", cxxopts::value<std::string>()->default_value("sah"))
+	("leaf-size", "Maximum number of triangles per leaf of the hierarchy", cxxopts::value<unsigned int>()->default_value("9"))
+	("input", "OBJ file containing input triangle mesh", cxxopts::value<std::vector<std::string>>())
+	;
+
+	try
+	{
+		options.parse_positional("input");
+		auto result = options.parse(argc, argv);
+
+		if (result.count("help"))
+		{
+			std::cout << options.help() << std::endl;
+			std::cout << std::endl << std::endl << "Example: BenchmarkDistance -r \"256 256 256\" --fraction 0.01 dragon.obj" << std::endl;
+			exit(0);
+		}
+		if (!result.count("input"))
+		{
+			std::cout << "ERROR: No input file given." << std::endl;
+			std::cout << options.help() << std::endl;
+			std::cout << std::endl << std::endl << "Example: BenchmarkDistance -r \"256 256 256\" --fraction 0.01 dragon.obj" << std::endl;
+			exit(1);
+		}
+
+		auto filename = result["input"].as<std::vector<std::string>>().front();
+		if (!std::ifstream(filename).good())
+		{
+			std::cerr << "ERROR: Input file does not exist!" << std::endl;
+			exit(1);
+		}
+
+		std::cout << "Load mesh...";
+		std::unique_ptr<Discregrid::TriangleMesh> input(new Discregrid::TriangleMesh(filename));
+		if (auto n_subdivisions = result["subdivide"].as<unsigned int>())
+		{
+			auto vertices = input->vertex_data();
+			auto faces = input->face_data();
+			for (auto i = 0u; i < n_subdivisions; ++i)
+				subdivide(vertices, faces);
+			input.reset(new Discregrid::TriangleMesh(vertices, faces));
+		}
+		auto const& mesh = *input;
+		std::cout << "DONE (" << mesh.nFaces() << " triangles)" << std::endl;
+
+		auto split_strategy = Discregrid::SplitStrategy::Median;
+		auto split = result["split"].as<std::string>();
+		if (split == "sah")
+			split_strategy = Discregrid::SplitStrategy::SurfaceArea;
+		else if (split == "volume")
+			split_strategy = Discregrid::SplitStrategy::Volume;
+		else if (split != "median")
+		{
+			std::cerr << "ERROR: Unknown split strategy " << split << "!" << std::endl;
+			exit(1);
+		}
+		auto leaf_size = result["leaf-size"].as<unsigned int>();
+
+		auto bounding_volume = Discregrid::BoundingVolume::Sphere;
+		auto hull = result["hull"].as<std::string>();
+		if (hull == "box")
+			bounding_volume = Discregrid::BoundingVolume::Box;
+		else if (hull != "sphere")
+		{
+			std::cerr << "ERROR: Unknown hull type " << hull << "!" << std::endl;
+			exit(1);
+		}
+
+		std::cout << "Build bounding " << hull << " hierarchy...";
+		auto build_time = bounding_volume == Discregrid::BoundingVolume::Sphere ?
+			buildTime<Discregrid::TriangleMeshBSH>(mesh, split_strategy, leaf_size) :
+			buildTime<Discregrid::TriangleMeshBBH>(mesh, split_strategy, leaf_size);
+		std::cout << "DONE (" << std::fixed << std::setprecision(3) << build_time << " s)" << std::endl;
+
+		std::cout << "Set up data structures...";
+		std::unique_ptr<Discregrid::MeshDistance> md;
+		auto setup_time = timed([&]() { md.reset(new Discregrid::MeshDistance(mesh, true, bounding_volume, split_strategy, leaf_size)); });
+		std::cout << "DONE (" << std::fixed << std::setprecision(3) << setup_time << " s)" << std::endl;
+
+		// Same domain as chosen by GenerateSDF for the default margin. Larger margins add queries
+		// far from the mesh.
+		auto domain = AlignedBox3f{};
+		for (auto const& x : mesh.vertices())
+			domain.extend(x);
+		auto margin = result["margin"].as<float>() * domain.diagonal().norm();
+		domain.max() += margin * Vector3f::Ones();
+		domain.min() -= margin * Vector3f::Ones();
+
+		auto resolution = result["r"].as<std::array<unsigned int, 3>>();
+		auto p = gridSamplePoints(domain, resolution, result["fraction"].as<float>(), result["seed"].as<unsigned int>());
+		auto n = p.x.size();
+		auto n_tiles = static_cast<int>(p.offsets.size() - 1u);
+
+		auto scalar = std::vector<float>(n), batch = std::vector<float>(n);
+		auto signed_scalar = std::vector<float>(n), signed_batch = std::vector<float>(n);
+
+		std::cout << std::endl << "Throughput (" << n << " nodes of " << n_tiles << " tiles of a "
+			<< resolution[0] << "x" << resolution[1] << "x" << resolution[2] << " grid):" << std::endl;
+
+		// The tiles are handed out like in CubicLagrangeDiscreteGrid::addFunction.
+		auto t_scalar = timed([&]()
+		{
+#pragma omp parallel for schedule(dynamic, 1)
+			for (int t = 0; t < n_tiles; ++t)
+				for (auto i = p.offsets[t]; i < p.offsets[t + 1]; ++i)
+					scalar[i] = md->unsignedDistance({p.x[i], p.y[i], p.z[i]});
+		});
+		report("distance", n, t_scalar, t_scalar);
+
+		auto t_batch = timed([&]()
+		{
+#pragma omp parallel for schedule(dynamic, 1)
+			for (int t = 0; t < n_tiles; ++t)
+			{
+				auto b = p.offsets[t];
+				md->distanceBatch(p.offsets[t + 1] - b, &p.x[b], &p.y[b], &p.z[b], &batch[b]);
+			}
+		});
+		report("distanceBatch", n, t_batch, t_scalar);
+
+		auto t_signed_scalar = timed([&]()
+		{
+#pragma omp parallel for schedule(dynamic, 1)
+			for (int t = 0; t < n_tiles; ++t)
+				for (auto i = p.offsets[t]; i < p.offsets[t + 1]; ++i)
+					signed_scalar[i] = md->signedDistance({p.x[i], p.y[i], p.z[i]});
+		});
+		report("signedDistance", n, t_signed_scalar, t_signed_scalar);
+
+		auto t_signed_batch = timed([&]()
+		{
+#pragma omp parallel for schedule(dynamic, 1)
+			for (int t = 0; t < n_tiles; ++t)
+			{
+				auto b = p.offsets[t];
+				md->signedDistanceBatch(p.offsets[t + 1] - b, &p.x[b], &p.y[b], &p.z[b], &signed_batch[b]);
+			}
+		});
+		report("signedDistanceBatch", n, t_signed_batch, t_signed_scalar);
+
+		// Traversal effort of the point by point queries, gathered in a separate pass.
+		auto statistics = std::vector<Discregrid::MeshDistance::QueryStatistics>(n_tiles);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int t = 0; t < n_tiles; ++t)
+			for (auto i = p.offsets[t]; i < p.offsets[t + 1]; ++i)
+				md->distance({p.x[i], p.y[i], p.z[i]}, nullptr, nullptr, nullptr, &statistics[t]);
+		auto total = Discregrid::MeshDistance::QueryStatistics{};
+		for (auto const& s : statistics)
+		{
+			total.n_queries += s.n_queries;
+			total.nodes_visited += s.nodes_visited;
+			total.triangles_tested += s.triangles_tested;
+		}
+		auto per_query = [&](std::size_t v) { return static_cast<double>(v) / static_cast<double>(std::max(total.n_queries, std::size_t{1})); };
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << "\tNodes visited per query: " << per_query(total.nodes_visited) << std::endl;
+		std::cout << "\tTriangles tested per query: " << per_query(total.triangles_tested) << std::endl;
+
+		auto max_diff = 0.0f, max_diff_signed = 0.0f;
+		for (auto i = 0u; i < n; ++i)
+		{
+			max_diff = std::max(max_diff, std::abs(scalar[i] - batch[i]));
+			max_diff_signed = std::max(max_diff_signed, std::abs(signed_scalar[i] - signed_batch[i]));
+		}
+		std::cout << std::scientific << std::setprecision(2);
+		std::cout << "\tMax. deviation between scalar and batch distances: " << max_diff << std::endl;
+		std::cout << "\tMax. deviation between scalar and batch signed distances: " << max_diff_signed << std::endl;
+	}
+	catch (cxxopts::OptionException const& e)
+	{
+		std::cout << "error parsing options: " << e.what() << std::endl;
+		exit(1);
+	}
+
+	return 0;
+}
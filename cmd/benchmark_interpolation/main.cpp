@@ -0,0 +1,229 @@
+#include <Discregrid/All>
+#include <Eigen/Dense>
+#include <cxxopts/cxxopts.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace Eigen;
+
+namespace
+{
+
+struct QueryPoints
+{
+	std::vector<float> x, y, z;
+};
+
+QueryPoints randomQueryPoints(AlignedBox3f const& domain, std::size_t n, unsigned int seed)
+{
+	auto gen = std::mt19937(seed);
+	auto ux = std::uniform_real_distribution<float>(domain.min()[0], domain.max()[0]);
+	auto uy = std::uniform_real_distribution<float>(domain.min()[1], domain.max()[1]);
+	auto uz = std::uniform_real_distribution<float>(domain.min()[2], domain.max()[2]);
+
+	auto q = QueryPoints{};
+	q.x.resize(n);
+	q.y.resize(n);
+	q.z.resize(n);
+	for (auto i = 0u; i < n; ++i)
+	{
+		q.x[i] = ux(gen);
+		q.y[i] = uy(gen);
+		q.z[i] = uz(gen);
+	}
+	return q;
+}
+
+// Returns the given query points reordered along a z-curve over the grid cells, such that
+// consecutive queries mostly fall into the same or neighboring cells.
+QueryPoints coherentQueryPoints(Discregrid::DiscreteGrid const& grid, QueryPoints const& q)
+{
+	auto n = q.x.size();
+	auto order = grid.zCurveOrder(n, q.x.data(), q.y.data(), q.z.data());
+
+	auto r = QueryPoints{};
+	r.x.resize(n);
+	r.y.resize(n);
+	r.z.resize(n);
+	for (auto i = 0u; i < n; ++i)
+	{
+		r.x[i] = q.x[order[i]];
+		r.y[i] = q.y[order[i]];
+		r.z[i] = q.z[order[i]];
+	}
+	return r;
+}
+
+// Runs f the given number of times and returns the best observed wall time in seconds.
+template <typename F>
+double bestOf(unsigned int repetitions, F const& f)
+{
+	using namespace std::chrono;
+	auto best = std::numeric_limits<double>::max();
+	for (auto r = 0u; r < repetitions; ++r)
+	{
+		auto t0 = high_resolution_clock::now();
+		f();
+		auto t1 = high_resolution_clock::now();
+		best = std::min(best, duration<double>(t1 - t0).count());
+	}
+	return best;
+}
+
+void report(std::string const& name, std::size_t n, double seconds)
+{
+	std::cout << "\t" << std::left << std::setw(28) << name << std::right
+		<< std::setw(12) << std::fixed << std::setprecision(2) << 1.0e-6 * static_cast<double>(n) / seconds << " Mqueries/s"
+		<< std::setw(12) << std::setprecision(3) << 1.0e3 * seconds << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	cxxopts::Options options(argv[0], "Measures the query throughput of a discrete field.");
+	options.positional_help("[input discrete grid file]");
+
+	options.add_options()
+	("h,help", "Prints this help text")
+	("f,field_id", "ID of the discrete field to evaluate", cxxopts::value<unsigned int>()->default_value("0"))
+	("n,queries", "Number of query points", cxxopts::value<unsigned int>()->default_value("1000000"))
+	("repetitions", "Number of timed repetitions (best time is reported)", cxxopts::value<unsigned int>()->default_value("5"))
+	("m,map", "Memory-maps the input file (mappable format only) instead of loading it")
+	("seed", "Seed of the random query point generator", cxxopts::value<unsigned int>()->default_value("0"))
+	("input", "Discrete grid file (cdf or cdm format)", cxxopts::value<std::vector<std::string>>())
+	;
+
+	try
+	{
+		options.parse_positional("input");
+		auto result = options.parse(argc, argv);
+
+		if (result.count("help"))
+		{
+			std::cout << options.help() << std::endl;
+			std::cout << std::endl << std::endl << "Example: BenchmarkInterpolation -n 1000000 dragon.cdf" << std::endl;
+			exit(0);
+		}
+		if (!result.count("input"))
+		{
+			std::cout << "ERROR: No input file given." << std::endl;
+			std::cout << options.help() << std::endl;
+			std::cout << std::endl << std::endl << "Example: BenchmarkInterpolation -n 1000000 dragon.cdf" << std::endl;
+			exit(1);
+		}
+
+		auto filename = result["input"].as<std::vector<std::string>>().front();
+		if (!std::ifstream(filename).good())
+		{
+			std::cerr << "ERROR: Input file does not exist!" << std::endl;
+			exit(1);
+		}
+
+		auto grid = std::unique_ptr<Discregrid::CubicLagrangeDiscreteGrid>(new Discregrid::CubicLagrangeDiscreteGrid());
+		auto open_time = bestOf(1u, [&]()
+		{
+			if (result.count("map"))
+			{
+				std::cout << "Map discrete grid...";
+				if (!grid->mapFile(filename))
+					exit(1);
+			}
+			else
+			{
+				std::cout << "Load discrete grid...";
+				grid->load(filename);
+			}
+		});
+		std::cout << "DONE (" << std::fixed << std::setprecision(3) << 1.0e3 * open_time << " ms)" << std::endl;
+
+		auto field_id = result["f"].as<unsigned int>();
+		auto n = static_cast<std::size_t>(result["n"].as<unsigned int>());
+		auto repetitions = std::max(1u, result["repetitions"].as<unsigned int>());
+		auto random = randomQueryPoints(grid->domain(), n, result["seed"].as<unsigned int>());
+		auto coherent = coherentQueryPoints(*grid, random);
+
+		auto values = std::vector<float>(n);
+		auto values_batch = std::vector<float>(n);
+		auto gx = std::vector<float>(n), gy = std::vector<float>(n), gz = std::vector<float>(n);
+		auto gx_batch = std::vector<float>(n), gy_batch = std::vector<float>(n), gz_batch = std::vector<float>(n);
+
+		// Queries are issued through the base class as a simulation would do.
+		Discregrid::DiscreteGrid const& base = *grid;
+
+		auto run = [&](std::string const& description, QueryPoints const& q)
+		{
+			auto scalar = [&](bool with_gradient)
+			{
+#pragma omp parallel for schedule(static)
+				for (int i = 0; i < static_cast<int>(n); ++i)
+				{
+					auto x = Vector3f{q.x[i], q.y[i], q.z[i]};
+					if (!with_gradient)
+					{
+						values[i] = base.interpolate(field_id, x);
+						continue;
+					}
+					auto gradient = Vector3f{};
+					values[i] = base.interpolate(field_id, x, &gradient);
+					gx[i] = gradient[0];
+					gy[i] = gradient[1];
+					gz[i] = gradient[2];
+				}
+			};
+
+			std::cout << std::endl << "Throughput (" << n << " " << description << " queries, best of " << repetitions << "):" << std::endl;
+			report("scalar", n, bestOf(repetitions, [&]() { scalar(false); }));
+			report("batch", n, bestOf(repetitions, [&]()
+			{
+				base.interpolateBatch(field_id, n, q.x.data(), q.y.data(), q.z.data(), values_batch.data());
+			}));
+			report("scalar + gradient", n, bestOf(repetitions, [&]() { scalar(true); }));
+			report("batch + gradient", n, bestOf(repetitions, [&]()
+			{
+				base.interpolateBatch(field_id, n, q.x.data(), q.y.data(), q.z.data(), values_batch.data(),
+					gx_batch.data(), gy_batch.data(), gz_batch.data());
+			}));
+
+			auto max_diff = 0.0f;
+			auto max_diff_gradient = 0.0f;
+			for (auto i = 0u; i < n; ++i)
+			{
+				if (values[i] == std::numeric_limits<float>::max() || values_batch[i] == std::numeric_limits<float>::max())
+				{
+					if (values[i] != values_batch[i])
+						max_diff = std::numeric_limits<float>::infinity();
+					continue;
+				}
+				max_diff = std::max(max_diff, std::abs(values[i] - values_batch[i]));
+				max_diff_gradient = std::max({max_diff_gradient, std::abs(gx[i] - gx_batch[i]),
+					std::abs(gy[i] - gy_batch[i]), std::abs(gz[i] - gz_batch[i])});
+			}
+			std::cout << "\tMax. deviation between scalar and batch results: " << max_diff << std::endl;
+			std::cout << "\tMax. deviation between scalar and batch gradients: " << max_diff_gradient << std::endl;
+		};
+
+		std::cout << std::endl << "Node-indexed cell layout" << std::endl;
+		run("random", random);
+		run("coherent", coherent);
+
+		grid->bake(field_id);
+		std::cout << std::endl << "Baked cell layout" << std::endl;
+		run("random", random);
+		run("coherent", coherent);
+	}
+	catch (cxxopts::OptionException const& e)
+	{
+		std::cout << "error parsing options: " << e.what() << std::endl;
+		exit(1);
+	}
+
+	return 0;
+}
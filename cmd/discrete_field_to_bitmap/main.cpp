@@ -127,13 +127,13 @@ int main(int argc, char* argv[])
 			auto x = domain.min()(dir(0)) + xr * diag(dir(0)) + 0.5 * xwidth;
 			auto y = domain.min()(dir(1)) + yr * diag(dir(1)) + 0.5 * ywidth;
 
-			auto sample = Vector3d{};
+			auto sample = Vector3f{};
 			sample(dir(0)) = x;
 			sample(dir(1)) = y;
-			sample(dir(2)) = domain.min()(dir(2)) + 0.5 * (1.0 + depth) * diag(dir(2));
+			sample(dir(2)) = static_cast<float>(domain.min()(dir(2)) + 0.5 * (1.0 + depth) * diag(dir(2)));
 
 			data[k] = sdf->interpolate(field_id, sample);
-			if (data[k] == std::numeric_limits<double>::max())
+			if (data[k] == std::numeric_limits<float>::max())
 			{
 				data[k] = 0.0;
 			}
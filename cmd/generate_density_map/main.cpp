@@ -86,19 +86,20 @@ int main(int argc, char* argv[])
 		auto gamma = [&](Vector3d const& x)
 		{
 			auto ar = sph_kernel.getRadius();
-			auto dist = sdf->interpolate(0u, x);
+			auto dist = sdf->interpolate(0u, x.cast<float>());
 			if (dist > ar)
 				return 0.0;
 			return 1.0 - dist / ar;
 		};
 		auto int_domain = AlignedBox3d(Vector3d::Constant(-h), Vector3d::Constant(h));
 		auto rho0 = result["r"].as<double>();
-		auto density_func = [&](Vector3d const& x)
+		auto density_func = [&](Vector3f const& xf)
 		{
-			auto dist = sdf->interpolate(0u, x);
+			auto x = xf.cast<double>().eval();
+			auto dist = sdf->interpolate(0u, xf);
 			if (dist > 2.0 * sph_kernel.getRadius())
 			{
-				return 0.0;
+				return 0.0f;
 			}
 
 			auto integrand = [&sph_kernel, &gamma, &x](Vector3d const& xi)
@@ -108,7 +109,7 @@ int main(int argc, char* argv[])
 			};
 
 			auto res = GaussQuadrature::integrate(integrand, int_domain, 30);
-			return rho0 * res;
+			return static_cast<float>(rho0 * res);
 		};
 
 		auto no_reduction = result["no-reduction"].count() > 0u;
@@ -116,7 +117,7 @@ int main(int argc, char* argv[])
 
 		auto cell_diag = sdf->cellSize().norm();
 		std::cout << "Generate density map..." << std::endl;
-		sdf->addFunction(density_func, true, [&](Vector3d const& x_)
+		sdf->addFunction(density_func, true, [&](Vector3f const& x_)
 		{
 			if (no_reduction)
 			{
@@ -124,7 +125,7 @@ int main(int argc, char* argv[])
 			}
 			auto x = x_.cwiseMax(sdf->domain().min()).cwiseMin(sdf->domain().max());
 			auto dist = sdf->interpolate(0u, x);
-			if (dist == std::numeric_limits<double>::max())
+			if (dist == std::numeric_limits<float>::max())
 			{
 				return false;
 			}
@@ -135,11 +136,11 @@ int main(int argc, char* argv[])
 		if (result["no-reduction"].count() == 0u)
 		{
 			std::cout << "Reduce discrete fields...";
-			sdf->reduceField(0u, [&](const Vector3d &, double v)
+			sdf->reduceField(0u, [&](const Vector3f &, float v)
 			{
 				return -6.0 * h < v + cell_diag && v - cell_diag < 2.0 * h;
 			});
-			sdf->reduceField(1u, [&](const Vector3d &, double v)
+			sdf->reduceField(1u, [&](const Vector3f &, float v)
 			{
 				return 0.0 <= v && v <= 3.0 * rho0;
 			});
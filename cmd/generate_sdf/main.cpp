@@ -7,6 +7,9 @@
 #include <string>
 #include <iostream>
 #include <array>
+#include <vector>
+#include <algorithm>
+#include <memory>
 
 using namespace Eigen;
 
@@ -16,7 +19,7 @@ std::istream& operator>>(std::istream& is, std::array<unsigned int, 3>& data)
 	return is;  
 }  
 
-std::istream& operator>>(std::istream& is, AlignedBox3d& data)  
+std::istream& operator>>(std::istream& is, AlignedBox3f& data)  
 {  
 	is	>> data.min()[0] >> data.min()[1] >> data.min()[2]
 		>> data.max()[0] >> data.max()[1] >> data.max()[2];  
@@ -25,6 +28,68 @@ std::istream& operator>>(std::istream& is, AlignedBox3d& data)
 
 #include <cxxopts/cxxopts.hpp>
 
+// Conservative lower bound of the unsigned distance to the mesh. The distance is only evaluated
+// at the centers of coarse blocks of cells. As the distance function is 1-Lipschitz, every block
+// center c yields the bound d(x) >= d(c) - |x - c|, of which the eight centers surrounding x
+// are considered.
+class DistanceLowerBound
+{
+public:
+	DistanceLowerBound(Discregrid::MeshDistance const& md, AlignedBox3f const& domain,
+		std::array<unsigned int, 3> const& resolution, unsigned int block_size)
+		: m_domain(domain)
+	{
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			m_n[i] = std::max((resolution[i] + block_size - 1) / block_size, 2u);
+			m_block_size[i] = domain.diagonal()[i] / static_cast<float>(m_n[i]);
+		}
+		m_center_distance.resize(m_n[0] * m_n[1] * m_n[2]);
+
+		#pragma omp parallel for schedule(dynamic, 16)
+		for (int l = 0; l < static_cast<int>(m_center_distance.size()); ++l)
+		{
+			m_center_distance[l] = md.unsignedDistance(center(l % m_n[0], (l / m_n[0]) % m_n[1], l / (m_n[0] * m_n[1])));
+		}
+	}
+
+	float operator()(Vector3f const& x) const
+	{
+		// Multi-index of the block center below x in the lattice of block centers.
+		std::array<unsigned int, 3> b;
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			auto t = (x[i] - m_domain.min()[i]) / m_block_size[i] - 0.5f;
+			b[i] = static_cast<unsigned int>(std::min(std::max(t, 0.0f), static_cast<float>(m_n[i] - 2)));
+		}
+
+		auto bound = 0.0f;
+		for (unsigned int k = 0; k < 2; ++k)
+			for (unsigned int j = 0; j < 2; ++j)
+				for (unsigned int i = 0; i < 2; ++i)
+				{
+					auto l = (b[2] + k) * m_n[0] * m_n[1] + (b[1] + j) * m_n[0] + b[0] + i;
+					auto c = center(b[0] + i, b[1] + j, b[2] + k);
+					bound = std::max(bound, m_center_distance[l] - (x - c).norm());
+				}
+		return bound;
+	}
+
+private:
+	Vector3f center(unsigned int i, unsigned int j, unsigned int k) const
+	{
+		return m_domain.min() + Vector3f(
+			(static_cast<float>(i) + 0.5f) * m_block_size[0],
+			(static_cast<float>(j) + 0.5f) * m_block_size[1],
+			(static_cast<float>(k) + 0.5f) * m_block_size[2]);
+	}
+
+	AlignedBox3f m_domain;
+	std::array<unsigned int, 3> m_n;
+	Vector3f m_block_size;
+	std::vector<float> m_center_distance;
+};
+
 int main(int argc, char* argv[])
 {
 	cxxopts::Options options(argv[0], "Generates a signed distance field from a closed two-manifold triangle mesh.");
@@ -33,9 +98,15 @@ int main(int argc, char* argv[])
 	options.add_options()
 	("h,help", "Prints this help text")
 	("r,resolution", "Grid resolution", cxxopts::value<std::array<unsigned int, 3>>()->default_value("10 10 10"))
-	("d,domain", "Domain extents (bounding box), format: \"minX minY minZ maxX maxY maxZ\"", cxxopts::value<AlignedBox3d>())
+	("d,domain", "Domain extents (bounding box), format: \"minX minY minZ maxX maxY maxZ\"", cxxopts::value<AlignedBox3f>())
 	("i,invert", "Invert SDF")
 	("o,output", "Ouput file in cdf format", cxxopts::value<std::string>()->default_value(""))
+	("m,mappable", "Writes the output in the aligned format that can be memory-mapped")
+	("b,bricked", "Stores the coefficients grouped by vertex in bricks of 4x4x4 vertices for faster queries")
+	("band", "Only computes the distance at nodes of cells closer to the surface than the given width, the remaining cells are undefined", cxxopts::value<float>())
+	("s,sparse", "Only stores the bricks of 8x8x8 cells containing computed nodes (requires --band)")
+	("sweep", "Fills the cells outside of the band by fast sweeping instead of leaving them undefined (requires --band)")
+	("hierarchical", "Fills the cells outside of the band from coarser levels of a grid hierarchy instead of leaving them undefined (requires --band)")
 	("input", "OBJ file containing input triangle mesh", cxxopts::value<std::vector<std::string>>())
 	;
 
@@ -74,11 +145,11 @@ int main(int argc, char* argv[])
 		Discregrid::MeshDistance md(mesh);
 		std::cout << "DONE" << std::endl;
 
-		Eigen::AlignedBox3d domain;
+		Eigen::AlignedBox3f domain;
 		domain.setEmpty();
 		if (result.count("d"))
 		{
-			domain = result["d"].as<Eigen::AlignedBox3d>();
+			domain = result["d"].as<Eigen::AlignedBox3f>();
 		}
 		if (domain.isEmpty())
 		{
@@ -86,23 +157,79 @@ int main(int argc, char* argv[])
 			{
 				domain.extend(x);
 			}
-			domain.max() += 1.0e-3 * domain.diagonal().norm() * Vector3d::Ones();
-			domain.min() -= 1.0e-3 * domain.diagonal().norm() * Vector3d::Ones();
+			domain.max() += 1.0e-3f * domain.diagonal().norm() * Vector3f::Ones();
+			domain.min() -= 1.0e-3f * domain.diagonal().norm() * Vector3f::Ones();
+		}
+
+		if (result.count("sparse") && (!result.count("band") || result.count("mappable") || result.count("bricked")))
+		{
+			std::cerr << "ERROR: --sparse requires --band and cannot be combined with --mappable or --bricked." << std::endl;
+			exit(1);
+		}
+		if (result.count("sweep") && (!result.count("band") || result.count("sparse")))
+		{
+			std::cerr << "ERROR: --sweep requires --band and cannot be combined with --sparse." << std::endl;
+			exit(1);
+		}
+		if (result.count("hierarchical") && (!result.count("band") || result.count("sparse") || result.count("sweep")))
+		{
+			std::cerr << "ERROR: --hierarchical requires --band and cannot be combined with --sparse or --sweep." << std::endl;
+			exit(1);
 		}
 
-		Discregrid::CubicLagrangeDiscreteGrid sdf(domain, resolution);
 		auto func = Discregrid::DiscreteGrid::ContinuousFunction{};
 		if (result.count("invert"))
 		{
-			func = [&md](Vector3d const& xi) {return -1.0 * md.signedDistanceCached(xi); };
+			func = [&md](Vector3f const& xi) {return -1.0f * md.signedDistanceCached(xi); };
 		}
 		else
 		{
-			func = [&md](Vector3d const& xi) {return md.signedDistanceCached(xi); };
+			func = [&md](Vector3f const& xi) {return md.signedDistanceCached(xi); };
 		}
 
+		// In narrow band mode, a node is sampled if it may lie within the band widened by one cell
+		// diagonal, such that all nodes of every cell intersecting the band are defined.
+		auto pred = Discregrid::DiscreteGrid::SamplePredicate{};
+		std::unique_ptr<DistanceLowerBound> lower_bound;
+		if (result.count("band") && !result.count("hierarchical"))
+		{
+			std::cout << "Classify far field...";
+			auto cell_diagonal = (domain.diagonal().array() / Array3f(
+				static_cast<float>(resolution[0]), static_cast<float>(resolution[1]), static_cast<float>(resolution[2]))).matrix().norm();
+			auto threshold = result["band"].as<float>() + cell_diagonal;
+			lower_bound.reset(new DistanceLowerBound(md, domain, resolution, 4u));
+			pred = [&lower_bound, threshold](Vector3f const& x) { return (*lower_bound)(x) <= threshold; };
+			std::cout << "DONE" << std::endl;
+		}
+
+		std::unique_ptr<Discregrid::DiscreteGrid> sdf;
+		if (result.count("sparse"))
+			sdf.reset(new Discregrid::SparseCubicLagrangeDiscreteGrid(domain, resolution));
+		else
+			sdf.reset(new Discregrid::CubicLagrangeDiscreteGrid(domain, resolution));
+
 		std::cout << "Generate discretization..." << std::endl;
-		sdf.addFunction(func, true);
+		auto order = result.count("bricked") ? Discregrid::CubicLagrangeDiscreteGrid::NodeOrder::Bricked : Discregrid::CubicLagrangeDiscreteGrid::NodeOrder::Lexicographic;
+		if (result.count("hierarchical"))
+			static_cast<Discregrid::CubicLagrangeDiscreteGrid&>(*sdf).addFunctionHierarchical(func, result["band"].as<float>(), 1.0f, true, order);
+		else if (result.count("sweep"))
+			static_cast<Discregrid::CubicLagrangeDiscreteGrid&>(*sdf).addDistanceFunction(func, pred, true, order);
+		else
+		{
+			// The nodes of a tile or brick are close to each other and are thus evaluated as packets.
+			auto sign = result.count("invert") ? -1.0f : 1.0f;
+			auto batch_func = Discregrid::DiscreteGrid::BatchFunction([&md, sign](std::size_t n,
+				float const* xs, float const* ys, float const* zs, float* values)
+			{
+				md.signedDistanceBatch(n, xs, ys, zs, values);
+				for (auto i = 0u; i < n; ++i)
+					values[i] *= sign;
+			});
+			if (result.count("sparse"))
+				sdf->addFunction(batch_func, true, pred);
+			else
+				static_cast<Discregrid::CubicLagrangeDiscreteGrid&>(*sdf).addFunction(batch_func, true, pred, order);
+		}
 		std::cout << "DONE" << std::endl;
 
 		std::cout << "Serialize discretization...";
@@ -117,7 +244,10 @@ int main(int argc, char* argv[])
 			}
 			output_file += ".cdf";
 		}
-		sdf.save(output_file);
+		if (result.count("mappable"))
+			static_cast<Discregrid::CubicLagrangeDiscreteGrid const&>(*sdf).saveMappable(output_file);
+		else
+			sdf->save(output_file);
 		std::cout << "DONE" << std::endl;
 	}
 	catch (cxxopts::OptionException const& e)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <random>
 #include <vector>
 
 namespace Discregrid
@@ -175,11 +176,14 @@ namespace Discregrid
             const int n = int(v.size());
 
             //generate random permutation of the points and perturb the points by epsilon to avoid corner cases
+            //a local generator instead of rand() allows for concurrent, reproducible constructions
             const float epsilon = 1.0e-6f;
+            std::minstd_rand gen(static_cast<std::minstd_rand::result_type>(n));
+            std::uniform_real_distribution<float> u(-1.0f, 1.0f);
             for (int i = n - 1; i > 0; i--)
             {
-                const Eigen::Vector3f epsilon_vec = epsilon * Eigen::Vector3f::Random();
-                const int j = static_cast<int>(floor(i * float(rand()) / RAND_MAX));
+                const Eigen::Vector3f epsilon_vec = epsilon * Eigen::Vector3f(u(gen), u(gen), u(gen));
+                const int j = std::uniform_int_distribution<int>(0, i)(gen);
                 d = v[i] + epsilon_vec;
                 v[i] = v[j] - epsilon_vec;
                 v[j] = d;
@@ -16,7 +16,10 @@ namespace Discregrid
                         std::vector<std::array<unsigned int, 3>> const &faces);
 
         Eigen::Vector3f const &entityPosition(unsigned int i) const final;
+        Eigen::AlignedBox3f entityBounds(unsigned int i) const final;
         void computeHull(unsigned int b, unsigned int n, BoundingSphere &hull) const final;
+        void mergeHulls(unsigned int b, unsigned int n, BoundingSphere const &hull0,
+                        BoundingSphere const &hull1, BoundingSphere &hull) const final;
 
     private:
         std::vector<Eigen::Vector3f> const &m_vertices;
@@ -34,7 +37,10 @@ namespace Discregrid
                         std::vector<std::array<unsigned int, 3>> const &faces);
 
         Eigen::Vector3f const &entityPosition(unsigned int i) const final;
+        Eigen::AlignedBox3f entityBounds(unsigned int i) const final;
         void computeHull(unsigned int b, unsigned int n, Eigen::AlignedBox3f &hull) const final;
+        void mergeHulls(unsigned int b, unsigned int n, Eigen::AlignedBox3f const &hull0,
+                        Eigen::AlignedBox3f const &hull1, Eigen::AlignedBox3f &hull) const final;
 
     private:
         std::vector<Eigen::Vector3f> const &m_vertices;
@@ -55,6 +61,8 @@ namespace Discregrid
         Eigen::Vector3f const &entityPosition(unsigned int i) const final;
         void computeHull(unsigned int b, unsigned int n, BoundingSphere &hull)
             const final;
+        void mergeHulls(unsigned int b, unsigned int n, BoundingSphere const &hull0,
+                        BoundingSphere const &hull1, BoundingSphere &hull) const final;
 
     private:
         std::vector<Eigen::Vector3f> const *m_vertices;
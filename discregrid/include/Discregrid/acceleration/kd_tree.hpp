@@ -3,12 +3,15 @@
 #include <algorithm>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <queue>
 #include <vector>
 
 #include <Eigen/Dense>
 
+#include "../utility/aligned_allocator.hpp"
+
 #include <array>
 #include <list>
 #include <stack>
@@ -16,6 +19,19 @@
 namespace Discregrid
 {
 
+    // Choice of the split of the nodes of a KDTree during its construction.
+    enum class SplitStrategy
+    {
+        // Halves the entities at the median of their positions along the longest side of the
+        // node's bounding box.
+        Median,
+        // Minimizes the sum of the surface areas of the children's hulls weighted by their numbers
+        // of entities. The candidate splits are evaluated over 16 bins per axis.
+        SurfaceArea,
+        // As SurfaceArea, but with the volumes of the hulls.
+        Volume
+    };
+
     template <typename HullType>
     class KDTree
     {
@@ -44,6 +60,23 @@ namespace Discregrid
             unsigned int n;
         };
 
+        // Node of the flattened hierarchy. The nodes are stored in depth-first order, such that the
+        // first child of an internal node directly follows it, and each node occupies 32 bytes for
+        // spheres and boxes, i.e. at most a single cache line.
+        struct alignas(32) FlatNode
+        {
+            bool isLeaf() const { return n > 0u; }
+
+            HullType hull;
+
+            // Index of the second child for internal nodes. Index of the first entry in the entity
+            // list for leaves.
+            unsigned int index;
+
+            // Number of owned entries of a leaf, zero for internal nodes.
+            unsigned int n;
+        };
+
         struct QueueItem
         {
             unsigned int n, d;
@@ -58,6 +91,13 @@ namespace Discregrid
         Node const &node(unsigned int i) const { return m_nodes[i]; }
         HullType const &hull(unsigned int i) const { return m_hulls[i]; }
         unsigned int entity(unsigned int i) const { return m_lst[i]; }
+        FlatNode const &flatNode(unsigned int i) const { return m_flat_nodes[i]; }
+
+        // Configures the construction. Nodes owning at most max_leaf_size entries are not split.
+        void setSplitStrategy(SplitStrategy strategy) { m_split_strategy = strategy; }
+        SplitStrategy splitStrategy() const { return m_split_strategy; }
+        void setMaxLeafSize(unsigned int max_leaf_size) { m_max_leaf_size = std::max(max_leaf_size, 1u); }
+        unsigned int maxLeafSize() const { return m_max_leaf_size; }
 
         void construct();
         void update();
@@ -65,24 +105,108 @@ namespace Discregrid
                                 TraversalPriorityLess const &pless = nullptr) const;
         void traverseBreadthFirst(TraversalPredicate const &pred, TraversalCallback const &cb, unsigned int start_node = 0, TraversalPriorityLess const &pless = nullptr, TraversalQueue &pending = TraversalQueue()) const;
 
+        // Iterative counterpart of traverseDepthFirst visiting the nodes in the same order. The
+        // callables are template parameters such that they are inlined into the traversal instead
+        // of being copied and invoked through std::function at every node. The node indices passed
+        // to the callables refer to the flattened hierarchy, see flatNode.
+        template <typename Predicate, typename Callback, typename PriorityLess>
+        void traverseDepthFirstIterative(Predicate const &pred, Callback const &cb, PriorityLess const &pless) const;
+        template <typename Predicate, typename Callback>
+        void traverseDepthFirstIterative(Predicate const &pred, Callback const &cb) const;
+
+        // Best-first traversal guided by key(node_index), a lower bound of the values sought in the
+        // subtree of a node, e.g. the squared distance between a query point and its hull. bound refers to the best value found so far, which may be
+        // decreased by the callables. The nearer child of a node is visited right away and the
+        // other one deferred to a min-heap, from which the nearest node is taken whenever a leaf is
+        // reached. Nodes whose key exceeds bound are skipped, and the traversal ends as soon as the
+        // smallest deferred key does. The node indices refer to the flattened hierarchy.
+        template <typename Key, typename Callback>
+        void traverseBestFirst(Key const &key, Callback const &cb, float const &bound) const;
+
     protected:
-        void construct(unsigned int node, Eigen::AlignedBox3f const &box,
+        // Recursively splits nodes[node], which owns the entries [b, b + n), and appends its
+        // descendants to nodes.
+        void construct(std::vector<Node> &nodes, unsigned int node, Eigen::AlignedBox3f const &box,
                        unsigned int b, unsigned int n);
+
+        // Partitions the entries [b, b + n) according to the split strategy and returns the size of
+        // the first part. box bounds the positions of the entries; the boxes of both parts are
+        // written to l_box and r_box.
+        unsigned int split(Eigen::AlignedBox3f const &box, unsigned int b, unsigned int n,
+                           Eigen::AlignedBox3f &l_box, Eigen::AlignedBox3f &r_box);
+        unsigned int splitMedian(Eigen::AlignedBox3f const &box, unsigned int b, unsigned int n,
+                                 Eigen::AlignedBox3f &l_box, Eigen::AlignedBox3f &r_box);
+        unsigned int splitBinned(Eigen::AlignedBox3f const &box, unsigned int b, unsigned int n,
+                                 Eigen::AlignedBox3f &l_box, Eigen::AlignedBox3f &r_box);
+
+        // Computes the hulls of all nodes bottom-up, level by level in parallel.
+        void computeHulls();
+
         void traverseDepthFirst(unsigned int node, unsigned int depth,
                                 TraversalPredicate pred, TraversalCallback cb, TraversalPriorityLess const &pless) const;
         void traverseBreadthFirst(TraversalQueue &pending,
                                   TraversalPredicate const &pred, TraversalCallback const &cb, TraversalPriorityLess const &pless = nullptr) const;
 
-        unsigned int addNode(unsigned int b, unsigned int n);
+        // Stores the nodes and hulls in the flattened depth-first layout.
+        void flatten();
+
+        // Stack of pending nodes of an iterative traversal. The first entries reside on the call
+        // stack; deeper trees spill into a heap allocated vector.
+        class TraversalStack
+        {
+        public:
+            bool empty() const { return m_n == 0u && m_overflow.empty(); }
+            void push(QueueItem const &item)
+            {
+                if (m_n < m_local.size())
+                    m_local[m_n++] = item;
+                else
+                    m_overflow.push_back(item);
+            }
+            QueueItem pop()
+            {
+                if (m_overflow.empty())
+                    return m_local[--m_n];
+                auto item = m_overflow.back();
+                m_overflow.pop_back();
+                return item;
+            }
+
+        private:
+            std::array<QueueItem, 64> m_local;
+            unsigned int m_n = 0u;
+            std::vector<QueueItem> m_overflow;
+        };
+
+        // Deferred node of a best-first traversal.
+        struct HeapItem
+        {
+            float key;
+            unsigned int n, d;
+        };
 
         virtual Eigen::Vector3f const &entityPosition(unsigned int i) const = 0;
+
+        // Bounding box of entity i, used by the surface area and volume heuristics. Defaults to the
+        // entity position.
+        virtual Eigen::AlignedBox3f entityBounds(unsigned int i) const;
+
         virtual void computeHull(unsigned int b, unsigned int n, HullType &hull) const = 0;
 
+        // Computes the hull of the internal node owning the entries [b, b + n) given the hulls of
+        // its children. The default implementation ignores the latter and calls computeHull.
+        virtual void mergeHulls(unsigned int b, unsigned int n, HullType const &hull0,
+                                HullType const &hull1, HullType &hull) const;
+
     protected:
         std::vector<unsigned int> m_lst;
 
         std::vector<Node> m_nodes;
         std::vector<HullType> m_hulls;
+        std::vector<FlatNode, AlignedAllocator<FlatNode, 32>> m_flat_nodes;
+
+        SplitStrategy m_split_strategy = SplitStrategy::Median;
+        unsigned int m_max_leaf_size = 9u;
     };
 
 #include "kd_tree.inl"
@@ -7,6 +7,7 @@ void KDTree<HullType>::construct()
 {
     m_nodes.clear();
     m_hulls.clear();
+    m_flat_nodes.clear();
     if (m_lst.empty())
         return;
 
@@ -17,19 +18,171 @@ void KDTree<HullType>::construct()
     for (auto i = 0u; i < m_lst.size(); ++i)
         box.extend(entityPosition(i));
 
-    auto ni = addNode(0, static_cast<unsigned int>(m_lst.size()));
-    construct(ni, box, 0, static_cast<unsigned int>(m_lst.size()));
+    // The upper levels are split serially until the subtrees are small enough to keep all threads
+    // busy. The subtrees own disjoint ranges of the entity list and are then built in parallel.
+    auto n_entities = static_cast<unsigned int>(m_lst.size());
+    auto const grain = std::max(n_entities / 64u, 1024u);
+    m_nodes.push_back({0u, n_entities});
+    auto subtrees = std::vector<std::pair<unsigned int, Eigen::AlignedBox3f>>{};
+    auto pending = std::vector<std::pair<unsigned int, Eigen::AlignedBox3f>>{{0u, box}};
+    while (!pending.empty())
+    {
+        auto ni = pending.back().first;
+        auto ni_box = pending.back().second;
+        pending.pop_back();
+
+        auto b = m_nodes[ni].begin;
+        auto n = m_nodes[ni].n;
+        if (n < grain || n <= m_max_leaf_size)
+        {
+            subtrees.push_back({ni, ni_box});
+            continue;
+        }
+
+        auto l_box = Eigen::AlignedBox3f{}, r_box = Eigen::AlignedBox3f{};
+        auto hal = split(ni_box, b, n, l_box, r_box);
+        auto n0 = static_cast<unsigned int>(m_nodes.size());
+        m_nodes.push_back({b, hal});
+        m_nodes.push_back({b + hal, n - hal});
+        m_nodes[ni].children = {{static_cast<int>(n0), static_cast<int>(n0 + 1u)}};
+        pending.push_back({n0 + 1u, r_box});
+        pending.push_back({n0, l_box});
+    }
+
+    auto subtree_nodes = std::vector<std::vector<Node>>(subtrees.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < static_cast<int>(subtrees.size()); ++i)
+    {
+        auto const &root = m_nodes[subtrees[i].first];
+        auto &nodes = subtree_nodes[i];
+        nodes.push_back({root.begin, root.n});
+        construct(nodes, 0u, subtrees[i].second, root.begin, root.n);
+    }
+
+    // Append the subtrees. The local root is replaced by the node it was built for.
+    for (auto i = 0u; i < subtrees.size(); ++i)
+    {
+        auto const &nodes = subtree_nodes[i];
+        auto root = subtrees[i].first;
+        auto offset = static_cast<int>(m_nodes.size()) - 1;
+        auto global = [&](int c)
+        { return c < 0 ? c : (c == 0 ? static_cast<int>(root) : c + offset); };
+
+        m_nodes[root].children = {{global(nodes[0].children[0]), global(nodes[0].children[1])}};
+        for (auto j = 1u; j < nodes.size(); ++j)
+        {
+            m_nodes.push_back(nodes[j]);
+            m_nodes.back().children = {{global(nodes[j].children[0]), global(nodes[j].children[1])}};
+        }
+    }
+
+    computeHulls();
+    flatten();
+}
+
+template <typename HullType>
+void KDTree<HullType>::flatten()
+{
+    m_flat_nodes.clear();
+    m_flat_nodes.reserve(m_nodes.size());
+    if (m_nodes.empty())
+        return;
+
+    // Pending nodes along with the flattened index of the parent if they are a second child.
+    auto const no_parent = std::numeric_limits<unsigned int>::max();
+    auto pending = std::vector<std::array<unsigned int, 2>>{};
+    pending.push_back({{0u, no_parent}});
+    while (!pending.empty())
+    {
+        auto n = pending.back()[0];
+        auto parent = pending.back()[1];
+        pending.pop_back();
+
+        auto i = static_cast<unsigned int>(m_flat_nodes.size());
+        if (parent != no_parent)
+            m_flat_nodes[parent].index = i;
+
+        auto const &node = m_nodes[n];
+        m_flat_nodes.push_back({});
+        auto &flat = m_flat_nodes.back();
+        flat.hull = m_hulls[n];
+        if (node.isLeaf())
+        {
+            flat.index = node.begin;
+            flat.n = node.n;
+        }
+        else
+        {
+            flat.index = 0u;
+            flat.n = 0u;
+            pending.push_back({{static_cast<unsigned int>(node.children[1]), i}});
+            pending.push_back({{static_cast<unsigned int>(node.children[0]), no_parent}});
+        }
+    }
 }
 
 template <typename HullType>
-void KDTree<HullType>::construct(unsigned int node, Eigen::AlignedBox3f const &box, unsigned int b,
-                                 unsigned int n)
+void KDTree<HullType>::construct(std::vector<Node> &nodes, unsigned int node, Eigen::AlignedBox3f const &box,
+                                 unsigned int b, unsigned int n)
 {
     // If only one element is left end recursion.
     //if (n == 1) return;
-    if (n < 10)
+    if (n <= m_max_leaf_size)
         return;
 
+    auto l_box = Eigen::AlignedBox3f{}, r_box = Eigen::AlignedBox3f{};
+    auto hal = split(box, b, n, l_box, r_box);
+
+    auto n0 = static_cast<unsigned int>(nodes.size());
+    nodes.push_back({b, hal});
+    nodes.push_back({b + hal, n - hal});
+    nodes[node].children = {{static_cast<int>(n0), static_cast<int>(n0 + 1u)}};
+
+    construct(nodes, n0, l_box, b, hal);
+    construct(nodes, n0 + 1u, r_box, b + hal, n - hal);
+}
+
+namespace detail
+{
+
+    // Measures of the hulls of entities with the given bounds for the surface area and volume
+    // heuristics, up to constant factors.
+    inline float
+    hullMeasure(Eigen::AlignedBox3f const &bounds, SplitStrategy strategy, Eigen::AlignedBox3f const *)
+    {
+        auto e = bounds.sizes().eval();
+        if (strategy == SplitStrategy::SurfaceArea)
+            return e[0] * e[1] + e[1] * e[2] + e[2] * e[0];
+        return e[0] * e[1] * e[2];
+    }
+
+    // Spheres are approximated by the sphere circumscribing the bounds.
+    inline float
+    hullMeasure(Eigen::AlignedBox3f const &bounds, SplitStrategy strategy, BoundingSphere const *)
+    {
+        auto d2 = bounds.diagonal().squaredNorm();
+        if (strategy == SplitStrategy::SurfaceArea)
+            return d2;
+        return d2 * std::sqrt(d2);
+    }
+
+}
+
+template <typename HullType>
+unsigned int
+KDTree<HullType>::split(Eigen::AlignedBox3f const &box, unsigned int b, unsigned int n,
+                        Eigen::AlignedBox3f &l_box, Eigen::AlignedBox3f &r_box)
+{
+    if (m_split_strategy == SplitStrategy::Median)
+        return splitMedian(box, b, n, l_box, r_box);
+    return splitBinned(box, b, n, l_box, r_box);
+}
+
+template <typename HullType>
+unsigned int
+KDTree<HullType>::splitMedian(Eigen::AlignedBox3f const &box, unsigned int b, unsigned int n,
+                              Eigen::AlignedBox3f &l_box, Eigen::AlignedBox3f &r_box)
+{
     // Determine longest side of bounding box.
     auto max_dir = 0;
     auto d = box.diagonal().eval();
@@ -46,28 +199,170 @@ void KDTree<HullType>::construct(unsigned int node, Eigen::AlignedBox3f const &b
     }
 #endif
 
-    // Sort range according to center of the longest side.
-    std::sort(m_lst.begin() + b, m_lst.begin() + b + n,
-              [&](unsigned int a, unsigned int b)
-              {
-                  return entityPosition(a)(max_dir) < entityPosition(b)(max_dir);
-              });
-
+    // Partition range according to center of the longest side. Unlike a full sort, this takes
+    // linear time.
+    auto less = [&](unsigned int a, unsigned int b)
+    {
+        return entityPosition(a)(max_dir) < entityPosition(b)(max_dir);
+    };
     auto hal = n / 2;
-    auto n0 = addNode(b, hal);
-    auto n1 = addNode(b + hal, n - hal);
-    m_nodes[node].children[0] = n0;
-    m_nodes[node].children[1] = n1;
+    auto first = m_lst.begin() + b;
+    std::nth_element(first, first + hal, first + n, less);
+    auto l_max = *std::max_element(first, first + hal, less);
 
-    auto c = 0.5 * (entityPosition(m_lst[b + hal - 1])(max_dir) +
+    auto c = 0.5 * (entityPosition(l_max)(max_dir) +
                     entityPosition(m_lst[b + hal])(max_dir));
-    auto l_box = box;
+    l_box = box;
     l_box.max()(max_dir) = c;
-    auto r_box = box;
+    r_box = box;
     r_box.min()(max_dir) = c;
+    return hal;
+}
+
+template <typename HullType>
+unsigned int
+KDTree<HullType>::splitBinned(Eigen::AlignedBox3f const &box, unsigned int b, unsigned int n,
+                              Eigen::AlignedBox3f &l_box, Eigen::AlignedBox3f &r_box)
+{
+    struct Bin
+    {
+        Eigen::AlignedBox3f bounds, positions;
+        unsigned int n = 0u;
+    };
+    auto const n_bins = 16;
+
+    // The bins subdivide the bounding box of the entity positions evenly along each axis.
+    auto positions = Eigen::AlignedBox3f{};
+    for (auto i = b; i < b + n; ++i)
+        positions.extend(entityPosition(m_lst[i]));
+    auto lower = positions.min().eval();
+    auto extent = positions.sizes().eval();
+    auto bin = [&](Eigen::Vector3f const &x, int d)
+    {
+        return std::min(n_bins - 1, static_cast<int>(static_cast<float>(n_bins) * (x[d] - lower[d]) / extent[d]));
+    };
+
+    auto bins = std::array<std::array<Bin, n_bins>, 3>{};
+    for (auto i = b; i < b + n; ++i)
+    {
+        auto const &x = entityPosition(m_lst[i]);
+        auto bounds = entityBounds(m_lst[i]);
+        for (auto d = 0; d < 3; ++d)
+        {
+            if (extent[d] <= 0.0f)
+                continue;
+            auto &bi = bins[d][bin(x, d)];
+            bi.bounds.extend(bounds);
+            bi.positions.extend(x);
+            ++bi.n;
+        }
+    }
+
+    // Evaluates the cost of the splits between the bins of all axes. The costs of the entities on
+    // the right side are accumulated in a sweep from the right.
+    auto measure = [&](Eigen::AlignedBox3f const &bounds)
+    {
+        return detail::hullMeasure(bounds, m_split_strategy, static_cast<HullType const *>(nullptr));
+    };
+    auto best_cost = std::numeric_limits<float>::max();
+    auto best_d = -1, best_k = 0;
+    for (auto d = 0; d < 3; ++d)
+    {
+        if (extent[d] <= 0.0f)
+            continue;
+
+        auto right_cost = std::array<float, n_bins>{};
+        auto right = Eigen::AlignedBox3f{};
+        auto n_right = 0u;
+        for (auto k = n_bins - 1; k > 0; --k)
+        {
+            right.extend(bins[d][k].bounds);
+            n_right += bins[d][k].n;
+            right_cost[k] = n_right > 0u ? static_cast<float>(n_right) * measure(right) : 0.0f;
+        }
+
+        auto left = Eigen::AlignedBox3f{};
+        auto n_left = 0u;
+        for (auto k = 1; k < n_bins; ++k)
+        {
+            left.extend(bins[d][k - 1].bounds);
+            n_left += bins[d][k - 1].n;
+            if (n_left == 0u || n_left == n)
+                continue;
+            auto cost = static_cast<float>(n_left) * measure(left) + right_cost[k];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_d = d;
+                best_k = k;
+            }
+        }
+    }
+
+    // All positions fall into a single bin, e.g. if they coincide.
+    if (best_d < 0)
+        return splitMedian(box, b, n, l_box, r_box);
+
+    auto first = m_lst.begin() + b;
+    auto middle = std::partition(first, first + n, [&](unsigned int i)
+                                 { return bin(entityPosition(i), best_d) < best_k; });
+
+    l_box.setEmpty();
+    r_box.setEmpty();
+    for (auto k = 0; k < n_bins; ++k)
+        (k < best_k ? l_box : r_box).extend(bins[best_d][k].positions);
+    return static_cast<unsigned int>(middle - first);
+}
+
+template <typename HullType>
+void KDTree<HullType>::computeHulls()
+{
+    m_hulls.assign(m_nodes.size(), HullType{});
+    if (m_nodes.empty())
+        return;
+
+    // Children are stored behind their parents, hence the depths are known in a single pass.
+    auto depth = std::vector<unsigned int>(m_nodes.size(), 0u);
+    auto levels = std::vector<std::vector<unsigned int>>(1u);
+    for (auto i = 0u; i < m_nodes.size(); ++i)
+    {
+        if (levels.size() <= depth[i])
+            levels.resize(depth[i] + 1u);
+        levels[depth[i]].push_back(i);
+        if (!m_nodes[i].isLeaf())
+            for (auto c : m_nodes[i].children)
+                depth[c] = depth[i] + 1u;
+    }
+
+    for (auto l = levels.rbegin(); l != levels.rend(); ++l)
+    {
+        auto const &level = *l;
+#pragma omp parallel for schedule(static)
+        for (int j = 0; j < static_cast<int>(level.size()); ++j)
+        {
+            auto i = level[j];
+            auto const &nd = m_nodes[i];
+            if (nd.isLeaf())
+                computeHull(nd.begin, nd.n, m_hulls[i]);
+            else
+                mergeHulls(nd.begin, nd.n, m_hulls[nd.children[0]], m_hulls[nd.children[1]], m_hulls[i]);
+        }
+    }
+}
 
-    construct(m_nodes[node].children[0], l_box, b, hal);
-    construct(m_nodes[node].children[1], r_box, b + hal, n - hal);
+template <typename HullType>
+Eigen::AlignedBox3f
+KDTree<HullType>::entityBounds(unsigned int i) const
+{
+    auto const &x = entityPosition(i);
+    return Eigen::AlignedBox3f(x, x);
+}
+
+template <typename HullType>
+void KDTree<HullType>::mergeHulls(unsigned int b, unsigned int n, HullType const &,
+                                  HullType const &, HullType &hull) const
+{
+    computeHull(b, n, hull);
 }
 
 template <typename HullType>
@@ -153,6 +448,94 @@ void KDTree<HullType>::traverseDepthFirst(unsigned int node_index,
     //}
 }
 
+template <typename HullType>
+template <typename Predicate, typename Callback, typename PriorityLess>
+void KDTree<HullType>::traverseDepthFirstIterative(Predicate const &pred, Callback const &cb,
+                                                   PriorityLess const &pless) const
+{
+    if (m_flat_nodes.empty())
+        return;
+    if (!pred(0u, 0u))
+        return;
+
+    TraversalStack pending;
+    pending.push({0u, 0u});
+    while (!pending.empty())
+    {
+        auto item = pending.pop();
+        auto const &node = m_flat_nodes[item.n];
+
+        cb(item.n, item.d);
+        if (node.isLeaf() || !pred(item.n, item.d))
+            continue;
+
+        // The child to be visited first is pushed last.
+        auto children = std::array<int, 2>{{static_cast<int>(item.n + 1u), static_cast<int>(node.index)}};
+        if (!pless(children))
+        {
+            pending.push({item.n + 1u, item.d + 1u});
+            pending.push({node.index, item.d + 1u});
+        }
+        else
+        {
+            pending.push({node.index, item.d + 1u});
+            pending.push({item.n + 1u, item.d + 1u});
+        }
+    }
+}
+
+template <typename HullType>
+template <typename Predicate, typename Callback>
+void KDTree<HullType>::traverseDepthFirstIterative(Predicate const &pred, Callback const &cb) const
+{
+    traverseDepthFirstIterative(pred, cb, [](std::array<int, 2> const &)
+                                { return true; });
+}
+
+template <typename HullType>
+template <typename Key, typename Callback>
+void KDTree<HullType>::traverseBestFirst(Key const &key, Callback const &cb, float const &bound) const
+{
+    if (m_flat_nodes.empty())
+        return;
+
+    // Min-heap of the deferred nodes.
+    auto greater = [](HeapItem const &a, HeapItem const &b)
+    { return a.key > b.key; };
+    auto pending = std::vector<HeapItem>{};
+    pending.reserve(64u);
+
+    auto item = HeapItem{key(0u), 0u, 0u};
+    while (true)
+    {
+        if (item.key <= bound)
+        {
+            auto const &node = m_flat_nodes[item.n];
+            cb(item.n, item.d);
+            if (!node.isLeaf())
+            {
+                auto near = HeapItem{key(item.n + 1u), item.n + 1u, item.d + 1u};
+                auto far = HeapItem{key(node.index), node.index, item.d + 1u};
+                if (far.key < near.key)
+                    std::swap(near, far);
+                if (far.key <= bound)
+                {
+                    pending.push_back(far);
+                    std::push_heap(pending.begin(), pending.end(), greater);
+                }
+                item = near;
+                continue;
+            }
+        }
+
+        if (pending.empty() || pending.front().key > bound)
+            return;
+        std::pop_heap(pending.begin(), pending.end(), greater);
+        item = pending.back();
+        pending.pop_back();
+    }
+}
+
 template <typename HullType>
 void KDTree<HullType>::traverseBreadthFirst(TraversalPredicate const &pred,
                                             TraversalCallback const &cb, unsigned int start_node, TraversalPriorityLess const &pless,
@@ -166,28 +549,11 @@ void KDTree<HullType>::traverseBreadthFirst(TraversalPredicate const &pred,
     traverseBreadthFirst(pending, pred, cb, pless);
 }
 
-template <typename HullType>
-unsigned int
-KDTree<HullType>::addNode(unsigned int b, unsigned int n)
-{
-    HullType hull;
-    computeHull(b, n, hull);
-    m_hulls.push_back(hull);
-    m_nodes.push_back({b, n});
-    return static_cast<unsigned int>(m_nodes.size() - 1);
-}
-
 template <typename HullType>
 void KDTree<HullType>::update()
 {
-    traverseDepthFirst(
-        [&](unsigned int, unsigned int)
-        { return true; },
-        [&](unsigned int node_index, unsigned int)
-        {
-            auto const &nd = node(node_index);
-            computeHull(nd.begin, nd.n, hull(node_index));
-        });
+    computeHulls();
+    flatten();
 }
 
 template <typename HullType>
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "discrete_grid.hpp"
+
+#include <cstdint>
+
+namespace Discregrid
+{
+
+    /**
+	 * @brief hp-adaptive discretization following [KDBB17].
+	 * 
+	 * Every cell of the grid is the root of an octree. Each leaf of the octree carries a polynomial of
+	 * individual degree in a tensor product Legendre basis, determined by L2 projection of the input
+	 * function using Gauss-Legendre quadrature. Starting from quadratic polynomials on the grid cells,
+	 * a leaf whose estimated error exceeds the tolerance is either subdivided (h-refinement) or raised
+	 * in degree (p-refinement), depending on which option reduces the error more per additional
+	 * coefficient. Smooth regions are thereby resolved with large cells of high degree and features
+	 * such as edges with small cells. The discretization is discontinuous across cell boundaries.
+	 */
+    class AdaptiveDiscreteGrid : public DiscreteGrid
+    {
+    public:
+        AdaptiveDiscreteGrid(){};
+        AdaptiveDiscreteGrid(std::string const &filename);
+
+        /**
+	 * @brief Creates an adaptive grid whose octrees are rooted at the cells of the given resolution.
+	 * 
+	 * @param domain Domain of the discretization
+	 * @param resolution Number of root cells in each direction
+	 * @param tolerance Admissible root mean square error of the discretization within each leaf
+	 * @param max_depth Maximum number of subdivisions of a root cell
+	 * @param max_degree Maximum polynomial degree of a leaf, between 2 and 16
+	 */
+        AdaptiveDiscreteGrid(Eigen::AlignedBox3f const &domain, std::array<unsigned int, 3> const &resolution,
+                             float tolerance = 1.0e-3f, unsigned int max_depth = 4u, unsigned int max_degree = 8u);
+
+        void save(std::string const &filename) const override;
+        void load(std::string const &filename) override;
+
+        /**
+	 * @brief Discretizes func adaptively until the estimated error of every leaf falls below the tolerance.
+	 * 
+	 * The error of a leaf is estimated by comparing its polynomial with func at the Gauss points of the
+	 * next higher degree. The root cells are refined in parallel; func is therefore invoked concurrently.
+	 * 
+	 * @param func Function to be discretized
+	 * @param verbose Prints the progress of the construction
+	 * @param pred (Optional) leaves whose center does not fulfill the predicate are not refined
+	 * @return ID of the new discretization
+	 */
+        using DiscreteGrid::addFunction;
+        unsigned int addFunction(ContinuousFunction const &func, bool verbose = false,
+                                 SamplePredicate const &pred = nullptr) override;
+
+        float interpolate(unsigned int field_id, Eigen::Vector3f const &xi,
+                          Eigen::Vector3f *gradient = nullptr) const override;
+
+        // The leaves are not described by 32 cubic shape functions; determineShapeFunctions therefore
+        // always fails and the corresponding interpolate returns std::numeric_limits<float>::max().
+        bool determineShapeFunctions(unsigned int field_id, Eigen::Vector3f const &x,
+                                     std::array<unsigned int, 32> &cell, Eigen::Vector3f &c0, Eigen::Matrix<float, 32, 1> &N,
+                                     Eigen::Matrix<float, 32, 3> *dN = nullptr) const override;
+
+        float interpolate(unsigned int field_id, Eigen::Vector3f const &xi, const std::array<unsigned int, 32> &cell, const Eigen::Vector3f &c0, const Eigen::Matrix<float, 32, 1> &N,
+                          Eigen::Vector3f *gradient = nullptr, Eigen::Matrix<float, 32, 3> *dN = nullptr) const override;
+
+        // Number of leaves and of polynomial coefficients of the discretization with ID field_id.
+        std::size_t nLeaves(unsigned int field_id) const;
+        std::size_t nCoefficients(unsigned int field_id) const;
+
+        float tolerance() const { return m_tolerance; }
+        unsigned int maxDepth() const { return m_max_depth; }
+        unsigned int maxDegree() const { return m_max_degree; }
+
+    private:
+        struct Node
+        {
+            // Index of the first of eight consecutive children or no_child for a leaf.
+            std::uint32_t child;
+            // Offset of the (degree + 1)^3 Legendre coefficients of a leaf.
+            std::uint32_t offset;
+            std::uint32_t degree;
+        };
+
+        struct Field
+        {
+            // The first nodes are the roots, one per grid cell in the order of multiToSingleIndex.
+            std::vector<Node> nodes;
+            std::vector<float> coefficients;
+        };
+
+        // Determines the leaf containing x and the local coordinates xi in [-1, 1]^3 as well as the
+        // scaling of derivatives with respect to xi. Returns false if x lies outside of the domain.
+        bool locateLeaf(Field const &field, Eigen::Vector3f const &x, Node const *&leaf,
+                        Eigen::Vector3f &xi, Eigen::Vector3f &c0) const;
+
+    private:
+        float m_tolerance = 1.0e-3f;
+        unsigned int m_max_depth = 4u;
+        unsigned int m_max_degree = 8u;
+        std::vector<Field> m_fields;
+    };
+
+}
@@ -1,13 +1,28 @@
 #pragma once
 
 #include "discrete_grid.hpp"
+#include "utility/aligned_allocator.hpp"
+
+#include <cstdint>
+#include <memory>
 
 namespace Discregrid
 {
 
+    class MappedFile;
+
     class CubicLagrangeDiscreteGrid : public DiscreteGrid
     {
     public:
+        // Storage order of the coefficients of a discretization that has not been reduced.
+        enum class NodeOrder
+        {
+            // Vertices followed by the inner nodes of the x-, y- and z-edges, each in lexicographic order.
+            Lexicographic,
+            // Nodes grouped by vertex and the vertices by 4x4x4 bricks, see addFunction.
+            Bricked
+        };
+
         CubicLagrangeDiscreteGrid(){};
         CubicLagrangeDiscreteGrid(std::string const &filename);
         CubicLagrangeDiscreteGrid(Eigen::AlignedBox3f const &domain,
@@ -16,13 +31,127 @@ namespace Discregrid
         void save(std::string const &filename) const override;
         void load(std::string const &filename) override;
 
+        /**
+	 * @brief Writes the grid in the versioned, aligned format that can be memory-mapped by mapFile.
+	 * 
+	 * The format stores every array of every field contiguously at a 64 byte aligned offset in native
+	 * byte order. It can also be read by load.
+	 * 
+	 * @param filename Output file
+	 */
+        void saveMappable(std::string const &filename) const;
+
+        /**
+	 * @brief Memory-maps a file written by saveMappable and interprets the field data in place.
+	 * 
+	 * Opening is independent of the file size, pages are read on first access, and processes
+	 * mapping the same file share the page cache. Mapped fields are read-only; reduceField copies
+	 * a mapped field into memory before modifying it.
+	 * 
+	 * The file is rejected if its arrays exceed it, if the number of cells or the cell sizes do not
+	 * match the resolution and domain, or if a dense field has the wrong number of nodes. The node
+	 * indices of the cells and the cell map of reduced fields are trusted, as checking them would
+	 * require reading the whole file.
+	 * 
+	 * @param filename Input file
+	 * @return Success of the function.
+	 */
+        bool mapFile(std::string const &filename);
+
+        /**
+	 * @brief Discretizes func by sampling it at the nodes of the grid.
+	 * 
+	 * With NodeOrder::Bricked, the coefficients are stored grouped by grid vertex: every vertex owns
+	 * its own node and the two inner nodes of each edge leading to its neighbor in positive x-, y- and
+	 * z-direction. The vertices are stored in bricks of 4x4x4 vertices along a z-curve, such that
+	 * the 32 coefficients of a cell lie within a few cache lines. The order pads the vertex lattice
+	 * to a multiple of 4 in each direction; the unused entries are undefined.
+	 * 
+	 * @param func Function to be discretized
+	 * @param verbose Prints the progress of the construction
+	 * @param pred (Optional) only nodes fulfilling the predicate are sampled, the others are undefined
+	 * @param order Storage order of the node coefficients
+	 * @return ID of the new discretization
+	 */
+        unsigned int addFunction(ContinuousFunction const &func, bool verbose,
+                                 SamplePredicate const &pred, NodeOrder order);
+
+        // Discretizes func in lexicographic node order.
         unsigned int addFunction(ContinuousFunction const &func, bool verbose = false,
                                  SamplePredicate const &pred = nullptr) override;
 
+        /**
+	 * @brief Discretizes func like addFunction, passing the nodes to func in batches.
+	 * 
+	 * Each batch contains the nodes fulfilling pred of a tile of 8x8x8 vertices, i.e. at most 3584
+	 * neighboring nodes.
+	 */
+        unsigned int addFunction(BatchFunction const &func, bool verbose,
+                                 SamplePredicate const &pred, NodeOrder order);
+
+        // Discretizes func in lexicographic node order, passing the nodes to func in batches.
+        unsigned int addFunction(BatchFunction const &func, bool verbose = false,
+                                 SamplePredicate const &pred = nullptr) override;
+
+        /**
+	 * @brief Discretizes the signed distance function func, which is only evaluated at the nodes within the band.
+	 * 
+	 * The coefficients at the remaining nodes are determined by extendDistanceField instead of
+	 * evaluating func, which is considerably faster if func is expensive, e.g. a mesh distance query.
+	 * 
+	 * @param func Signed distance function to be discretized
+	 * @param band Nodes at which func is evaluated; should enclose the zero level set
+	 * @param verbose Prints the progress of the construction
+	 * @param order Storage order of the node coefficients
+	 * @return ID of the new discretization
+	 */
+        unsigned int addDistanceFunction(ContinuousFunction const &func, SamplePredicate const &band,
+                                         bool verbose = false, NodeOrder order = NodeOrder::Lexicographic);
+
+        /**
+	 * @brief Discretizes func by a coarse-to-fine construction that only evaluates func close to its zero level set.
+	 * 
+	 * The grid is discretized on a hierarchy of grids whose resolution is halved per level as long as
+	 * it remains at least 32 cells per direction, starting at the coarsest level where func is
+	 * evaluated at every node. On each finer level, the vertex bounds of the enclosing coarse cell
+	 * yield the lower bound |f(x)| >= |f(v)| - lipschitz * |x - v|. A node whose bound exceeds the
+	 * band widened by one cell diagonal takes the value of the coarse discretization instead of
+	 * evaluating func, clamped to the bound and to the sign of the coarse vertex. The number of
+	 * evaluations thereby scales with the area of the zero level set rather than with the volume of
+	 * the domain, while all cells intersecting the band are exact.
+	 * 
+	 * @param func Function to be discretized, e.g. a signed distance function
+	 * @param band Width of the band around the zero level set in which func is evaluated exactly
+	 * @param lipschitz Lipschitz constant of func, which is 1 for a distance function
+	 * @param verbose Prints the progress of the construction
+	 * @param order Storage order of the node coefficients
+	 * @return ID of the new discretization
+	 */
+        unsigned int addFunctionHierarchical(ContinuousFunction const &func, float band, float lipschitz = 1.0f,
+                                             bool verbose = false, NodeOrder order = NodeOrder::Lexicographic);
+
+        /**
+	 * @brief Fills the undefined coefficients of the distance field with ID field_id by fast sweeping.
+	 * 
+	 * The Eikonal equation |grad u| = 1 is solved on the grid vertices by a first order Godunov
+	 * upwind scheme, seeded by the defined vertex coefficients which are kept fixed. Each sweep
+	 * updates the diagonal planes of the vertex lattice in parallel. The undefined edge coefficients
+	 * are linearly interpolated from the vertices of their edge. The sign of a far-field value is
+	 * inherited from its upwind neighbors.
+	 * 
+	 * @param field_id Discretization ID
+	 * @return False if the field has been reduced or does not contain any defined vertex coefficient.
+	 */
+        bool extendDistanceField(unsigned int field_id);
+
         std::size_t nCells() const { return m_n_cells; };
         float interpolate(unsigned int field_id, Eigen::Vector3f const &xi,
                           Eigen::Vector3f *gradient = nullptr) const override;
 
+        void interpolateBatch(unsigned int field_id, std::size_t n,
+                              float const *xs, float const *ys, float const *zs, float *values,
+                              float *gx = nullptr, float *gy = nullptr, float *gz = nullptr) const override;
+
         /**
 	 * @brief Determines the shape functions for the discretization with ID field_id at point xi.
 	 * 
@@ -53,18 +182,108 @@ namespace Discregrid
         float interpolate(unsigned int field_id, Eigen::Vector3f const &xi, const std::array<unsigned int, 32> &cell, const Eigen::Vector3f &c0, const Eigen::Matrix<float, 32, 1> &N,
                           Eigen::Vector3f *gradient = nullptr, Eigen::Matrix<float, 32, 3> *dN = nullptr) const override;
 
+        /**
+	 * @brief Discards all cells of the discretization with ID field_id none of whose nodes fulfills pred.
+	 * 
+	 * The kept nodes are reordered along a z-curve. A field can be reduced repeatedly: reducing by
+	 * pred1 and then by pred2 keeps the cells containing a node fulfilling pred1 and one fulfilling
+	 * pred2, i.e. yields the same field as a single reduction by pred2 if pred2 implies pred1, such
+	 * as a narrower band. The reduction runs in parallel; pred is therefore invoked concurrently. Besides the input, the reduction temporarily
+	 * requires at most 13 bytes per node, 8 bytes per cell, 24 bytes per kept node and 128 bytes per
+	 * kept cell.
+	 * 
+	 * @param field_id Discretization ID
+	 * @param pred Predicate receiving the node position and its coefficient
+	 */
         void reduceField(unsigned int field_id, Predicate pred) override;
 
+        /**
+	 * @brief Stores the 32 coefficients of every cell of the discretization with ID field_id contiguously.
+	 * 
+	 * Interpolation then reads one cache-line aligned block of 128 bytes per query instead of gathering
+	 * 32 coefficients from scattered node indices. The baked layout requires 128 bytes per cell in addition
+	 * to the node coefficients, is kept up to date by reduceField and is not serialized.
+	 * 
+	 * @param field_id Discretization ID
+	 */
+        void bake(unsigned int field_id);
+        bool isBaked(unsigned int field_id) const;
+
         void forEachCell(unsigned int field_id,
                          std::function<void(unsigned int, Eigen::AlignedBox3f const &, unsigned int)> const &cb) const;
 
     private:
+        // Read-only view of the arrays of a field, which either live in the member vectors or in a
+        // memory-mapped file. Dense fields, i.e. fields that have not been reduced, store neither
+        // cells nor a cell map (both null); their node indices are computed by cellNodes.
+        struct FieldData
+        {
+            float const *nodes = nullptr;
+            std::array<unsigned int, 32> const *cells = nullptr;
+            unsigned int const *cell_map = nullptr;
+            std::uint32_t const *cell_valid = nullptr;
+            float const *baked = nullptr;
+            std::size_t n_nodes = 0u;
+            std::size_t n_cells = 0u;
+            NodeOrder node_order = NodeOrder::Lexicographic;
+        };
+
+        FieldData fieldData(unsigned int field_id) const;
+
+        // Copies a memory-mapped field into the member vectors so that it can be modified.
+        void detach(unsigned int field_id);
+
         Eigen::Vector3f indexToNodePosition(unsigned int l) const;
 
+        // Number of node coefficients of an unreduced field stored in the given order.
+        std::size_t nNodes(NodeOrder order) const;
+
+        // Determines the position of the node with index l in the given order. Returns false for the
+        // padding entries of the bricked order that do not correspond to a node.
+        bool nodePosition(unsigned int l, NodeOrder order, Eigen::Vector3f &x) const;
+
+        // Computes the indices of the nodes owned by vertex (i, j, k) of an unreduced field: the vertex
+        // node followed by the two inner nodes of its edges in positive x-, y- and z-direction. Entries
+        // of edges beyond the last vertex are std::numeric_limits<unsigned int>::max().
+        std::array<unsigned int, 7> vertexNodes(unsigned int i, unsigned int j, unsigned int k,
+                                                NodeOrder order = NodeOrder::Lexicographic) const;
+
+        // Computes the indices of the 32 nodes of the cell with linear index l of an unreduced field.
+        std::array<unsigned int, 32> cellNodes(unsigned int l, NodeOrder order = NodeOrder::Lexicographic) const;
+
+        // Gathers the 32 coefficients of the cell with the given (possibly reduced) index.
+        void gatherCell(FieldData const &fd, unsigned int cell_index, float *c) const;
+
+        // Stores the cells and the cell map of a dense field explicitly, e.g. prior to a reduction.
+        void makeConnectivityExplicit(unsigned int field_id);
+
+        // Releases the cells and the cell map of an unreduced field, whose connectivity is implicit.
+        void makeConnectivityImplicit(unsigned int field_id);
+
+        // Determines the (possibly reduced) cell containing x and the local coordinates xi in [-1, 1]^3.
+        // Returns false if x lies outside of the domain or in a discarded cell.
+        // A null cell_map denotes a dense field, for which the cell index is the linear grid index.
+        bool locateCell(unsigned int const *cell_map, Eigen::Vector3f const &x,
+                        unsigned int &cell_index, Eigen::Vector3f &xi, Eigen::Vector3f &c0) const;
+
+        // Marks the cells of the given field whose 32 coefficients are all defined, i.e. differ from
+        // std::numeric_limits<float>::max(). Must be called whenever m_nodes or m_cells change.
+        void updateCellValidity(unsigned int field_id);
+
     private:
         std::vector<std::vector<float>> m_nodes;
         std::vector<std::vector<std::array<unsigned int, 32>>> m_cells;
         std::vector<std::vector<unsigned int>> m_cell_map;
+        std::vector<std::vector<float, AlignedAllocator<float, 64>>> m_baked_cells;
+        // One bit per cell, set if all coefficients of the cell are defined.
+        std::vector<std::vector<std::uint32_t>> m_cell_valid;
+        // Determines the implicit connectivity of unreduced fields. Meaningless once a field has been
+        // reduced, since its nodes are then sorted along a z-curve and located by its cells only.
+        std::vector<NodeOrder> m_node_order;
+
+        // Fields with a non-null entry are served from the shared mapping instead of the vectors above.
+        std::shared_ptr<MappedFile const> m_mapping;
+        std::vector<FieldData> m_mapped_fields;
     };
 
 }
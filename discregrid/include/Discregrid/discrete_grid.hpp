@@ -3,6 +3,7 @@
 #include <Eigen/Dense>
 #include <array>
 #include <fstream>
+#include <functional>
 #include <vector>
 
 namespace Discregrid
@@ -16,6 +17,10 @@ namespace Discregrid
         using MultiIndex = std::array<unsigned int, 3>;
         using Predicate = std::function<bool(Eigen::Vector3f const &, float)>;
         using SamplePredicate = std::function<bool(Eigen::Vector3f const &)>;
+        // Evaluates a function at n points given in structure-of-arrays layout.
+        using BatchFunction = std::function<void(std::size_t n, float const *xs, float const *ys, float const *zs, float *values)>;
+        // Receives the number of completed and of total work items of a construction.
+        using ProgressCallback = std::function<void(std::size_t, std::size_t)>;
 
         DiscreteGrid() = default;
         DiscreteGrid(Eigen::AlignedBox3f const &domain, std::array<unsigned int, 3> const &resolution)
@@ -34,6 +39,21 @@ namespace Discregrid
         virtual unsigned int addFunction(ContinuousFunction const &func, bool verbose = false,
                                          SamplePredicate const &pred = nullptr) = 0;
 
+        /**
+	 * @brief Discretizes func like addFunction, but evaluates it for many nodes per call.
+	 * 
+	 * The batches consist of nodes that are close in space, such that func can share state between
+	 * the points or evaluate them using SIMD instructions. func is invoked concurrently for
+	 * different batches. The default implementation passes the nodes one by one.
+	 * 
+	 * @param func Function evaluating a batch of points
+	 * @param verbose Prints the progress of the construction
+	 * @param pred (Optional) only nodes fulfilling the predicate are sampled
+	 * @return ID of the new discretization
+	 */
+        virtual unsigned int addFunction(BatchFunction const &func, bool verbose = false,
+                                         SamplePredicate const &pred = nullptr);
+
         float interpolate(Eigen::Vector3f const &xi, Eigen::Vector3f *gradient = nullptr) const
         {
             return interpolate(0u, xi, gradient);
@@ -42,6 +62,23 @@ namespace Discregrid
         virtual float interpolate(unsigned int field_id, Eigen::Vector3f const &xi,
                                   Eigen::Vector3f *gradient = nullptr) const = 0;
 
+        /**
+	 * @brief Evaluates the discretization with ID field_id at n query points given in structure-of-arrays layout.
+	 * 
+	 * @param field_id Discretization ID
+	 * @param n Number of query points
+	 * @param xs x-coordinates of the query points
+	 * @param ys y-coordinates of the query points
+	 * @param zs z-coordinates of the query points
+	 * @param values Output array receiving the n interpolated values (std::numeric_limits<float>::max() where the field is undefined)
+	 * @param gx (Optional) output array receiving the x-components of the gradients
+	 * @param gy (Optional) output array receiving the y-components of the gradients
+	 * @param gz (Optional) output array receiving the z-components of the gradients
+	 */
+        virtual void interpolateBatch(unsigned int field_id, std::size_t n,
+                                      float const *xs, float const *ys, float const *zs, float *values,
+                                      float *gx = nullptr, float *gy = nullptr, float *gz = nullptr) const;
+
         /**
 	 * @brief Determines the shape functions for the discretization with ID field_id at point xi.
 	 * 
@@ -74,6 +111,32 @@ namespace Discregrid
 
         virtual void reduceField(unsigned int field_id, Predicate pred) {}
 
+        /**
+	 * @brief Installs a callback that is periodically invoked during addFunction.
+	 * 
+	 * The callback is invoked from a separate reporter thread, about twice per second and once
+	 * after the construction, while the workers only increment an atomic counter. The work items
+	 * are implementation specific, e.g. nodes or bricks.
+	 * 
+	 * @param callback Callback receiving the number of completed and of total work items, or nullptr
+	 */
+        void setProgressCallback(ProgressCallback const &callback) { m_progress_callback = callback; }
+
+        /**
+	 * @brief Computes the permutation that orders n points along a z-curve over the grid cells.
+	 * 
+	 * Queries issued in this order mostly fall into the same or neighboring cells, which improves the
+	 * cache reuse of interpolate and interpolateBatch, e.g. for particles that move little between
+	 * steps. Points outside of the domain are assigned to the nearest boundary cell.
+	 * 
+	 * @param n Number of points
+	 * @param xs x-coordinates of the points
+	 * @param ys y-coordinates of the points
+	 * @param zs z-coordinates of the points
+	 * @return Indices of the points in z-curve order
+	 */
+        std::vector<unsigned int> zCurveOrder(std::size_t n, float const *xs, float const *ys, float const *zs) const;
+
         MultiIndex singleToMultiIndex(unsigned int i) const;
         unsigned int multiToSingleIndex(MultiIndex const &ijk) const;
 
@@ -92,5 +155,6 @@ namespace Discregrid
         Eigen::Vector3f m_inv_cell_size;
         std::size_t m_n_cells;
         std::size_t m_n_fields;
+        ProgressCallback m_progress_callback;
     };
 }
\ No newline at end of file
@@ -39,7 +39,9 @@ namespace std
 #include <Discregrid/acceleration/bounding_sphere_hierarchy.hpp>
 
 #include <array>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <vector>
@@ -50,6 +52,15 @@ namespace Discregrid
 {
 
     enum class NearestEntity;
+
+    // Hull type of the hierarchy over the faces of a mesh. Spheres are cheaper to test, while boxes
+    // usually enclose the faces more tightly, e.g. those of axis aligned CAD models.
+    enum class BoundingVolume
+    {
+        Sphere,
+        Box
+    };
+
     class TriangleMesh;
     class Halfedge;
     class MeshDistance
@@ -63,13 +74,26 @@ namespace Discregrid
         };
 
     public:
-        MeshDistance(TriangleMesh const &mesh, bool precompute_normals = true);
+        // Traversal effort of distance queries, accumulated over all queries it is passed to.
+        struct QueryStatistics
+        {
+            std::size_t n_queries = 0u;
+            std::size_t nodes_visited = 0u;
+            std::size_t triangles_tested = 0u;
+        };
+
+        // The hierarchy over the faces is built from the given bounding volumes with the given split
+        // strategy and maximum number of faces per leaf, see KDTree.
+        MeshDistance(TriangleMesh const &mesh, bool precompute_normals = true,
+                     BoundingVolume bounding_volume = BoundingVolume::Sphere,
+                     SplitStrategy split_strategy = SplitStrategy::SurfaceArea, unsigned int max_leaf_size = 9u);
 
         // Returns the shortest unsigned distance from a given point x to
-        // the stored mesh.
+        // the stored mesh. The traversal effort is added to statistics if given.
         // Thread-safe function.
         float distance(Eigen::Vector3f const &x, Eigen::Vector3f *nearest_point = nullptr,
-                       unsigned int *nearest_face = nullptr, NearestEntity *ne = nullptr) const;
+                       unsigned int *nearest_face = nullptr, NearestEntity *ne = nullptr,
+                       QueryStatistics *statistics = nullptr) const;
 
         // Requires a closed two-manifold mesh as input data.
         // Thread-safe function.
@@ -79,28 +103,65 @@ namespace Discregrid
         float unsignedDistance(Eigen::Vector3f const &x) const;
         float unsignedDistanceCached(Eigen::Vector3f const &x) const;
 
+        // Computes the unsigned distances of n points given as coordinate arrays to the stored mesh.
+        // Consecutive points are grouped into packets of up to packet_size points that traverse the
+        // hierarchy together, which pays off if the points of a packet lie close to each other, e.g.
+        // the nodes of neighboring grid cells. The indices of the closest faces are optionally
+        // written to nearest_faces.
+        // Thread-safe function.
+        void distanceBatch(std::size_t n, float const *xs, float const *ys, float const *zs,
+                           float *distances, unsigned int *nearest_faces = nullptr) const;
+
+        // Batched counterpart of signedDistance. Requires a closed two-manifold mesh as input data.
+        // Thread-safe function.
+        void signedDistanceBatch(std::size_t n, float const *xs, float const *ys, float const *zs,
+                                 float *distances) const;
+
+        static constexpr unsigned int packet_size = 64u;
+
     private:
         Eigen::Vector3f vertex_normal(unsigned int v) const;
         Eigen::Vector3f edge_normal(Halfedge const &h) const;
         Eigen::Vector3f face_normal(unsigned int f) const;
 
-        void callback(unsigned int node_index, TriangleMeshBSH const &bsh,
-                      Eigen::Vector3f const &x,
-                      float &dist) const;
+        // The traversals are implemented for both hierarchy types, of which the one of m_bsh and
+        // m_bbh that is set is used.
+        template <typename Hierarchy>
+        float distance(Hierarchy const &hierarchy, Eigen::Vector3f const &x, Eigen::Vector3f *nearest_point,
+                       unsigned int *nearest_face, NearestEntity *ne, QueryStatistics *statistics) const;
 
-        bool predicate(unsigned int node_index, TriangleMeshBSH const &bsh,
-                       Eigen::Vector3f const &x, float &dist) const;
+        // Signed distance of x to the given face, which is assumed to be the closest one.
+        float signedDistance(Eigen::Vector3f const &x, unsigned int nearest_face) const;
+
+        // Pending node of a packet traversal along with the points of the packet that may still
+        // find a closer face in its subtree.
+        struct PacketItem
+        {
+            unsigned int node_index;
+            std::uint64_t active;
+        };
+
+        // Determines the distances and closest faces of n <= packet_size points in a single
+        // traversal of the hierarchy. warm_face, if valid, provides initial distance bounds.
+        template <typename Hierarchy>
+        void distancePacket(Hierarchy const &hierarchy, unsigned int n, Eigen::Vector3f const *x,
+                            unsigned int warm_face, std::vector<PacketItem> &stack, float *dist,
+                            unsigned int *nearest_face) const;
 
     private:
         TriangleMesh const &m_mesh;
-        TriangleMeshBSH m_bsh;
+        std::unique_ptr<TriangleMeshBSH> m_bsh;
+        std::unique_ptr<TriangleMeshBBH> m_bbh;
 
         using FunctionValueCache = LRUCache<Eigen::Vector3f, float>;
-        mutable std::vector<TriangleMeshBSH::TraversalQueue> m_queues;
         mutable std::vector<unsigned int> m_nearest_face;
         mutable std::vector<FunctionValueCache> m_cache;
         mutable std::vector<FunctionValueCache> m_ucache;
 
+        // Structure-of-arrays data of the faces in the order of the entity list of the hierarchy, such
+        // that the faces of a leaf are stored contiguously, see simd::TriangleData.
+        std::vector<float> m_triangle_data;
+
         std::vector<Eigen::Vector3f> m_face_normals;
         std::vector<Eigen::Vector3f> m_vertex_normals;
         bool m_precomputed_normals;
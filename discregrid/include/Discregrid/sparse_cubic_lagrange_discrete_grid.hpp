@@ -0,0 +1,124 @@
+#pragma once
+
+#include "discrete_grid.hpp"
+
+#include <cstdint>
+
+namespace Discregrid
+{
+
+    /**
+	 * @brief Cubic Lagrange discretization that only stores the active bricks of 8x8x8 cells.
+	 * 
+	 * The bricks of a field are found through a hash table keyed by brick coordinates. Each brick
+	 * stores the coefficients of all its nodes, including those on its faces, such that a query only
+	 * touches a single brick. Memory therefore scales with the number of active bricks, e.g. with the
+	 * surface area of a narrow band, instead of with the number of grid cells. The discretization
+	 * is identical to that of CubicLagrangeDiscreteGrid.
+	 */
+    class SparseCubicLagrangeDiscreteGrid : public DiscreteGrid
+    {
+    public:
+        SparseCubicLagrangeDiscreteGrid(){};
+        SparseCubicLagrangeDiscreteGrid(std::string const &filename);
+        SparseCubicLagrangeDiscreteGrid(Eigen::AlignedBox3f const &domain,
+                                        std::array<unsigned int, 3> const &resolution);
+
+        void save(std::string const &filename) const override;
+        void load(std::string const &filename) override;
+
+        /**
+	 * @brief Discretizes func by sampling it at the nodes of the grid brick by brick.
+	 * 
+	 * Only bricks containing at least one node that fulfills pred are stored; nodes not fulfilling
+	 * pred are undefined. The bricks are stored along a z-curve.
+	 * 
+	 * @param func Function to be discretized
+	 * @param verbose Prints the progress of the construction
+	 * @param pred (Optional) only nodes fulfilling the predicate are sampled
+	 * @return ID of the new discretization
+	 */
+        unsigned int addFunction(ContinuousFunction const &func, bool verbose = false,
+                                 SamplePredicate const &pred = nullptr) override;
+
+        // Discretizes func like addFunction, passing the sampled nodes of one brick per call.
+        unsigned int addFunction(BatchFunction const &func, bool verbose = false,
+                                 SamplePredicate const &pred = nullptr) override;
+
+        float interpolate(unsigned int field_id, Eigen::Vector3f const &xi,
+                          Eigen::Vector3f *gradient = nullptr) const override;
+
+        /**
+	 * @brief Determines the shape functions for the discretization with ID field_id at point xi.
+	 * 
+	 * The node indices returned in cell refer to the coefficients of the field and are valid until
+	 * the field is modified. Fails outside of the stored bricks and in cells discarded by reduceField.
+	 * 
+	 * @param field_id Discretization ID
+	 * @param x Location where the shape functions should be determined
+	 * @param cell cell of x
+	 * @param c0 vector required for the interpolation
+	 * @param N	shape functions for the cell of x
+	 * @param dN (Optional) derivatives of the shape functions, required to compute the gradient
+	 * @return Success of the function.
+	 */
+        bool determineShapeFunctions(unsigned int field_id, Eigen::Vector3f const &x,
+                                     std::array<unsigned int, 32> &cell, Eigen::Vector3f &c0, Eigen::Matrix<float, 32, 1> &N,
+                                     Eigen::Matrix<float, 32, 3> *dN = nullptr) const override;
+
+        float interpolate(unsigned int field_id, Eigen::Vector3f const &xi, const std::array<unsigned int, 32> &cell, const Eigen::Vector3f &c0, const Eigen::Matrix<float, 32, 1> &N,
+                          Eigen::Vector3f *gradient = nullptr, Eigen::Matrix<float, 32, 3> *dN = nullptr) const override;
+
+        /**
+	 * @brief Discards all cells of the discretization with ID field_id none of whose nodes fulfills pred.
+	 * 
+	 * Bricks without remaining cells are released. pred is invoked concurrently.
+	 * 
+	 * @param field_id Discretization ID
+	 * @param pred Predicate receiving the node position and its coefficient
+	 */
+        void reduceField(unsigned int field_id, Predicate pred) override;
+
+        // Number of stored bricks of the discretization with ID field_id.
+        std::size_t nBricks(unsigned int field_id) const;
+
+    private:
+        struct Field
+        {
+            // Brick coordinates packed into 21 bits per direction, one entry per stored brick.
+            std::vector<std::uint64_t> bricks;
+            // Coefficients of the nodes of each brick, see brickNodePosition.
+            std::vector<float> nodes;
+            // One bit per cell of each brick, set if the cell exists and all its coefficients are defined.
+            std::vector<std::uint32_t> cell_valid;
+
+            // Open addressing hash table with linear probing mapping brick keys to brick indices.
+            std::vector<std::uint64_t> table_keys;
+            std::vector<unsigned int> table_bricks;
+            unsigned int table_shift = 64u;
+        };
+
+        // Returns the index of the brick with the given key or std::numeric_limits<unsigned int>::max().
+        unsigned int findBrick(Field const &field, std::uint64_t key) const;
+
+        // Rebuilds the hash table of the field from its list of bricks.
+        void buildTable(Field &field) const;
+
+        // Determines the position of node l of the given brick. Returns false if the node lies outside
+        // of the grid.
+        bool brickNodePosition(std::uint64_t brick, unsigned int l, Eigen::Vector3f &x) const;
+
+        // Marks the cells of a brick that exist and whose coefficients are all defined.
+        void updateCellValidity(Field &field, unsigned int brick) const;
+
+        // Determines the brick and the index of the cell within the brick containing x as well as the
+        // local coordinates xi in [-1, 1]^3. Returns false if x lies outside of the domain or of the
+        // stored bricks.
+        bool locateCell(Field const &field, Eigen::Vector3f const &x, unsigned int &brick, unsigned int &cell,
+                        Eigen::Vector3f &xi, Eigen::Vector3f &c0) const;
+
+    private:
+        std::vector<Field> m_fields;
+    };
+
+}
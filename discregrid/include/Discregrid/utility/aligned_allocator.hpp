@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+namespace Discregrid
+{
+
+    // Minimal allocator returning storage aligned to Alignment bytes, e.g. to the size of a cache
+    // line. The pointer returned by ::operator new is stored in front of the aligned block.
+    template <typename T, std::size_t Alignment>
+    class AlignedAllocator
+    {
+        static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two.");
+
+    public:
+        using value_type = T;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() = default;
+        template <typename U>
+        AlignedAllocator(AlignedAllocator<U, Alignment> const &) {}
+
+        T *allocate(std::size_t n)
+        {
+            if (n > (std::numeric_limits<std::size_t>::max() - Alignment - sizeof(void *)) / sizeof(T))
+                throw std::bad_alloc();
+
+            auto raw = static_cast<char *>(::operator new(n * sizeof(T) + Alignment + sizeof(void *)));
+            auto addr = reinterpret_cast<std::uintptr_t>(raw + sizeof(void *));
+            auto aligned = reinterpret_cast<void **>((addr + Alignment - 1) & ~(std::uintptr_t(Alignment) - 1));
+            aligned[-1] = raw;
+            return reinterpret_cast<T *>(aligned);
+        }
+
+        void deallocate(T *p, std::size_t)
+        {
+            if (p)
+                ::operator delete(reinterpret_cast<void **>(p)[-1]);
+        }
+    };
+
+    template <typename T, typename U, std::size_t Alignment>
+    bool operator==(AlignedAllocator<T, Alignment> const &, AlignedAllocator<U, Alignment> const &) { return true; }
+
+    template <typename T, typename U, std::size_t Alignment>
+    bool operator!=(AlignedAllocator<T, Alignment> const &, AlignedAllocator<U, Alignment> const &) { return false; }
+
+}
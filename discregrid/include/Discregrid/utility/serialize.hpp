@@ -1,6 +1,7 @@
 #pragma once
 
 #include <streambuf>
+#include <type_traits>
 
 namespace Discregrid
 {
@@ -37,5 +38,22 @@ namespace Discregrid
             using details::write;
             return write(buf, val);
         }
+
+        // Reads n contiguous elements with a single call to the stream buffer.
+        template <class T>
+        bool readArray(std::streambuf &buf, T *data, std::size_t n)
+        {
+            static_assert(std::is_standard_layout<T>{}, "data is not standard layout");
+            auto bytes = static_cast<std::streamsize>(n * sizeof(T));
+            return buf.sgetn(reinterpret_cast<char *>(data), bytes) == bytes;
+        }
+        // Writes n contiguous elements with a single call to the stream buffer.
+        template <class T>
+        bool writeArray(std::streambuf &buf, T const *data, std::size_t n)
+        {
+            static_assert(std::is_standard_layout<T>{}, "data is not standard layout");
+            auto bytes = static_cast<std::streamsize>(n * sizeof(T));
+            return buf.sputn(reinterpret_cast<const char *>(data), bytes) == bytes;
+        }
     }
 }
\ No newline at end of file
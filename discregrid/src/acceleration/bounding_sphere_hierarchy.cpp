@@ -1,6 +1,8 @@
 
 #include <acceleration/bounding_sphere_hierarchy.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <set>
 
@@ -9,6 +11,40 @@ using namespace Eigen;
 namespace Discregrid
 {
 
+    namespace
+    {
+
+        // Nodes with up to this many entities, which are the ones most frequently visited by queries,
+        // get their smallest enclosing sphere. The hulls of larger nodes are merged from those of
+        // their children.
+        unsigned int const max_exact_hull_size = 128u;
+
+        // Smallest sphere enclosing the spheres s0 and s1.
+        BoundingSphere
+        enclosingSphere(BoundingSphere const &s0, BoundingSphere const &s1)
+        {
+            Vector3f d = s1.x() - s0.x();
+            auto dist = d.norm();
+            if (dist + s1.r() <= s0.r())
+                return s0;
+            if (dist + s0.r() <= s1.r())
+                return s1;
+
+            auto r = 0.5f * (dist + s0.r() + s1.r());
+            return BoundingSphere(s0.x() + ((r - s0.r()) / dist) * d, r);
+        }
+
+        // Shrinks the sphere to the farthest point of the node, given as the squared distance r2 to
+        // the center, but slightly enlarged such that round-off never moves a point outside.
+        BoundingSphere
+        shrunkSphere(BoundingSphere s, float r2)
+        {
+            s.r() = std::min(s.r(), (1.0f + 1.0e-6f) * std::sqrt(r2));
+            return s;
+        }
+
+    }
+
     TriangleMeshBSH::TriangleMeshBSH(
         std::vector<Vector3f> const &vertices,
         std::vector<std::array<unsigned int, 3>> const &faces)
@@ -28,6 +64,16 @@ namespace Discregrid
         return m_tri_centers[i];
     }
 
+    AlignedBox3f
+    TriangleMeshBSH::entityBounds(unsigned int i) const
+    {
+        auto const &f = m_faces[i];
+        auto bounds = AlignedBox3f(m_vertices[f[0]], m_vertices[f[0]]);
+        bounds.extend(m_vertices[f[1]]);
+        bounds.extend(m_vertices[f[2]]);
+        return bounds;
+    }
+
     void
     TriangleMeshBSH::computeHull(unsigned int b, unsigned int n, BoundingSphere &hull) const
     {
@@ -48,6 +94,27 @@ namespace Discregrid
         hull.r() = s.r();
     }
 
+    void
+    TriangleMeshBSH::mergeHulls(unsigned int b, unsigned int n, BoundingSphere const &hull0,
+                                BoundingSphere const &hull1, BoundingSphere &hull) const
+    {
+        if (n <= max_exact_hull_size)
+        {
+            computeHull(b, n, hull);
+            return;
+        }
+
+        // The enclosing sphere of the child spheres is centered close to the smallest enclosing
+        // sphere of the node. Keeping its center and shrinking the radius approximates the latter in
+        // time linear in the number of triangles, instead of running Welzl's algorithm per node.
+        auto s = enclosingSphere(hull0, hull1);
+        auto r2 = 0.0f;
+        for (auto i = b; i < b + n; ++i)
+            for (auto v : m_faces[m_lst[i]])
+                r2 = std::max(r2, (m_vertices[v] - s.x()).squaredNorm());
+        hull = shrunkSphere(s, r2);
+    }
+
     TriangleMeshBBH::TriangleMeshBBH(
         std::vector<Vector3f> const &vertices,
         std::vector<std::array<unsigned int, 3>> const &faces)
@@ -67,9 +134,20 @@ namespace Discregrid
         return m_tri_centers[i];
     }
 
+    AlignedBox3f
+    TriangleMeshBBH::entityBounds(unsigned int i) const
+    {
+        auto const &f = m_faces[i];
+        auto bounds = AlignedBox3f(m_vertices[f[0]], m_vertices[f[0]]);
+        bounds.extend(m_vertices[f[1]]);
+        bounds.extend(m_vertices[f[2]]);
+        return bounds;
+    }
+
     void
     TriangleMeshBBH::computeHull(unsigned int b, unsigned int n, AlignedBox3f &hull) const
     {
+        hull.setEmpty();
         for (auto i = 0u; i < n; ++i)
         {
             auto const &f = m_faces[m_lst[b + i]];
@@ -80,6 +158,13 @@ namespace Discregrid
         }
     }
 
+    void
+    TriangleMeshBBH::mergeHulls(unsigned int, unsigned int, AlignedBox3f const &hull0,
+                                AlignedBox3f const &hull1, AlignedBox3f &hull) const
+    {
+        hull = hull0.merged(hull1);
+    }
+
     PointCloudBSH::PointCloudBSH()
         : super(0)
     {
@@ -109,4 +194,21 @@ namespace Discregrid
         hull.r() = s.r();
     }
 
+    void
+    PointCloudBSH::mergeHulls(unsigned int b, unsigned int n, BoundingSphere const &hull0,
+                              BoundingSphere const &hull1, BoundingSphere &hull) const
+    {
+        if (n <= max_exact_hull_size)
+        {
+            computeHull(b, n, hull);
+            return;
+        }
+
+        auto s = enclosingSphere(hull0, hull1);
+        auto r2 = 0.0f;
+        for (auto i = b; i < b + n; ++i)
+            r2 = std::max(r2, ((*m_vertices)[m_lst[i]] - s.x()).squaredNorm());
+        hull = shrunkSphere(s, r2);
+    }
+
 }
@@ -0,0 +1,545 @@
+#include "adaptive_discrete_grid.hpp"
+#include "utility/progress.hpp"
+#include <utility/serialize.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+using namespace Eigen;
+
+namespace Discregrid
+{
+
+    namespace
+    {
+
+        std::uint32_t const no_child = std::numeric_limits<std::uint32_t>::max();
+        unsigned int const initial_degree = 2u;
+        unsigned int const max_degree_limit = 16u;
+
+        char const adaptive_magic[8] = {'D', 'S', 'C', 'R', 'A', 'D', 'P', 'T'};
+        std::uint32_t const adaptive_version = 1u;
+
+        // Evaluates the Legendre polynomials P_0, ..., P_p and optionally their derivatives at t.
+        template <class T>
+        inline void
+        legendre(unsigned int p, T t, T *P, T *dP = nullptr)
+        {
+            P[0] = T(1);
+            if (dP)
+                dP[0] = T(0);
+            if (p == 0u)
+                return;
+            P[1] = t;
+            if (dP)
+                dP[1] = T(1);
+            for (auto n = 1u; n < p; ++n)
+            {
+                P[n + 1] = (T(2 * n + 1) * t * P[n] - T(n) * P[n - 1]) / T(n + 1);
+                if (dP)
+                    dP[n + 1] = dP[n - 1] + T(2 * n + 1) * P[n];
+            }
+        }
+
+        // Gauss-Legendre quadrature rule with n points on [-1, 1].
+        struct GaussRule
+        {
+            std::vector<double> x;
+            std::vector<double> w;
+        };
+
+        GaussRule
+        gaussLegendre(unsigned int n)
+        {
+            auto rule = GaussRule{std::vector<double>(n), std::vector<double>(n)};
+            auto P = std::vector<double>(n + 1u);
+            auto dP = std::vector<double>(n + 1u);
+            for (auto i = 0u; i < n; ++i)
+            {
+                // Newton iteration on P_n starting from an approximation of the i-th root.
+                auto t = std::cos(3.14159265358979323846 * (i + 0.75) / (n + 0.5));
+                for (auto it = 0u; it < 100u; ++it)
+                {
+                    legendre(n, t, P.data(), dP.data());
+                    auto dt = P[n] / dP[n];
+                    t -= dt;
+                    if (std::abs(dt) < 1.0e-15)
+                        break;
+                }
+                legendre(n, t, P.data(), dP.data());
+                rule.x[i] = t;
+                rule.w[i] = 2.0 / ((1.0 - t * t) * dP[n] * dP[n]);
+            }
+            return rule;
+        }
+
+        // Applies the m x n matrix M (row-major) along direction d of the tensor t whose extents are
+        // given by dims, where dims[d] == n. The first direction is stored contiguously.
+        std::vector<double>
+        applyAlong(std::vector<double> const &t, std::array<unsigned int, 3> &dims, unsigned int d,
+                   std::vector<double> const &M, unsigned int m)
+        {
+            auto n = dims[d];
+            auto out_dims = dims;
+            out_dims[d] = m;
+            auto in_stride = std::array<unsigned int, 3>{{1u, dims[0], dims[0] * dims[1]}};
+
+            auto out = std::vector<double>(out_dims[0] * out_dims[1] * out_dims[2], 0.0);
+            auto o = out.begin();
+            for (auto k = 0u; k < out_dims[2]; ++k)
+                for (auto j = 0u; j < out_dims[1]; ++j)
+                    for (auto i = 0u; i < out_dims[0]; ++i, ++o)
+                    {
+                        auto idx = std::array<unsigned int, 3>{{i, j, k}};
+                        auto r = idx[d];
+                        idx[d] = 0u;
+                        auto base = idx[0] * in_stride[0] + idx[1] * in_stride[1] + idx[2] * in_stride[2];
+                        auto sum = 0.0;
+                        for (auto s = 0u; s < n; ++s)
+                            sum += M[r * n + s] * t[base + s * in_stride[d]];
+                        *o = sum;
+                    }
+
+            dims = out_dims;
+            return out;
+        }
+
+        // A candidate leaf: the L2 projection of the function onto the polynomials of the given degree
+        // and the root mean square error estimated at the Gauss points of the next higher degree.
+        struct Leaf
+        {
+            AlignedBox3f box;
+            unsigned int depth;
+            unsigned int degree;
+            std::vector<double> coefficients;
+            double error;
+        };
+
+        class LeafBuilder
+        {
+        public:
+            LeafBuilder(DiscreteGrid::ContinuousFunction const &func, unsigned int max_degree)
+                : m_func(func)
+            {
+                for (auto q = 0u; q <= max_degree + 2u; ++q)
+                    m_rules.push_back(gaussLegendre(q));
+            }
+
+            Leaf
+            operator()(AlignedBox3f const &box, unsigned int depth, unsigned int degree) const
+            {
+                auto const &rule = m_rules[degree + 2u];
+                auto q = static_cast<unsigned int>(rule.x.size());
+                auto p1 = degree + 1u;
+
+                auto f = std::vector<double>(q * q * q);
+                auto center = box.center();
+                auto half = (0.5f * box.diagonal()).eval();
+                for (auto c = 0u; c < q; ++c)
+                    for (auto b = 0u; b < q; ++b)
+                        for (auto a = 0u; a < q; ++a)
+                        {
+                            auto x = Vector3f(center[0] + half[0] * static_cast<float>(rule.x[a]),
+                                              center[1] + half[1] * static_cast<float>(rule.x[b]),
+                                              center[2] + half[2] * static_cast<float>(rule.x[c]));
+                            f[(c * q + b) * q + a] = m_func(x);
+                        }
+
+                // Projection matrix (2 i + 1) / 2 w_a P_i(x_a) and evaluation matrix P_i(x_a).
+                auto project = std::vector<double>(p1 * q);
+                auto evaluate = std::vector<double>(q * p1);
+                auto P = std::vector<double>(p1);
+                for (auto a = 0u; a < q; ++a)
+                {
+                    legendre(degree, rule.x[a], P.data());
+                    for (auto i = 0u; i < p1; ++i)
+                    {
+                        project[i * q + a] = 0.5 * (2.0 * i + 1.0) * rule.w[a] * P[i];
+                        evaluate[a * p1 + i] = P[i];
+                    }
+                }
+
+                auto dims = std::array<unsigned int, 3>{{q, q, q}};
+                auto coefficients = f;
+                for (auto d = 0u; d < 3u; ++d)
+                    coefficients = applyAlong(coefficients, dims, d, project, p1);
+
+                auto fit = coefficients;
+                for (auto d = 0u; d < 3u; ++d)
+                    fit = applyAlong(fit, dims, d, evaluate, q);
+
+                // The weights sum up to the volume 8 of the reference cell.
+                auto error = 0.0;
+                for (auto c = 0u; c < q; ++c)
+                    for (auto b = 0u; b < q; ++b)
+                        for (auto a = 0u; a < q; ++a)
+                        {
+                            auto l = (c * q + b) * q + a;
+                            auto e = f[l] - fit[l];
+                            error += rule.w[a] * rule.w[b] * rule.w[c] * e * e;
+                        }
+
+                return Leaf{box, depth, degree, std::move(coefficients), std::sqrt(error / 8.0)};
+            }
+
+        private:
+            DiscreteGrid::ContinuousFunction const &m_func;
+            std::vector<GaussRule> m_rules;
+        };
+
+        // Octree of a single root cell under construction; the root has index 0.
+        struct Tree
+        {
+            std::vector<std::uint32_t> child;
+            std::vector<std::uint32_t> degree;
+            std::vector<std::uint32_t> offset;
+            std::vector<float> coefficients;
+        };
+
+        inline AlignedBox3f
+        childBox(AlignedBox3f const &box, unsigned int c)
+        {
+            auto center = box.center();
+            auto child = box;
+            for (auto d = 0u; d < 3u; ++d)
+            {
+                if (c >> d & 1u)
+                    child.min()[d] = center[d];
+                else
+                    child.max()[d] = center[d];
+            }
+            return child;
+        }
+    } // namespace
+
+    AdaptiveDiscreteGrid::AdaptiveDiscreteGrid(std::string const &filename)
+    {
+        load(filename);
+    }
+
+    AdaptiveDiscreteGrid::AdaptiveDiscreteGrid(AlignedBox3f const &domain, std::array<unsigned int, 3> const &resolution,
+                                               float tolerance, unsigned int max_depth, unsigned int max_degree)
+        : DiscreteGrid(domain, resolution), m_tolerance(tolerance), m_max_depth(max_depth),
+          m_max_degree(std::min(std::max(max_degree, initial_degree), max_degree_limit))
+    {
+    }
+
+    void AdaptiveDiscreteGrid::save(std::string const &filename) const
+    {
+        auto out = std::ofstream(filename, std::ios::binary);
+        out.write(adaptive_magic, sizeof(adaptive_magic));
+        serialize::write(*out.rdbuf(), adaptive_version);
+        serialize::write(*out.rdbuf(), m_domain);
+        serialize::write(*out.rdbuf(), m_resolution);
+        serialize::write(*out.rdbuf(), m_cell_size);
+        serialize::write(*out.rdbuf(), m_inv_cell_size);
+        serialize::write(*out.rdbuf(), m_n_cells);
+        serialize::write(*out.rdbuf(), m_n_fields);
+        serialize::write(*out.rdbuf(), m_tolerance);
+        serialize::write(*out.rdbuf(), m_max_depth);
+        serialize::write(*out.rdbuf(), m_max_degree);
+
+        for (auto const &field : m_fields)
+        {
+            serialize::write(*out.rdbuf(), field.nodes.size());
+            serialize::write(*out.rdbuf(), field.coefficients.size());
+            serialize::writeArray(*out.rdbuf(), field.nodes.data(), field.nodes.size());
+            serialize::writeArray(*out.rdbuf(), field.coefficients.data(), field.coefficients.size());
+        }
+
+        out.close();
+    }
+
+    void AdaptiveDiscreteGrid::load(std::string const &filename)
+    {
+        auto in = std::ifstream(filename, std::ios::binary);
+
+        if (!in.good())
+        {
+            std::cerr << "ERROR: Discrete grid can not be loaded. Input file does not exist!" << std::endl;
+            return;
+        }
+
+        char magic[sizeof(adaptive_magic)] = {};
+        auto version = std::uint32_t{};
+        in.read(magic, sizeof(magic));
+        serialize::read(*in.rdbuf(), version);
+        if (std::memcmp(magic, adaptive_magic, sizeof(magic)) != 0 || version != adaptive_version)
+        {
+            std::cerr << "ERROR: Discrete grid can not be loaded. Input file is not an adaptive grid of a supported version!" << std::endl;
+            return;
+        }
+
+        serialize::read(*in.rdbuf(), m_domain);
+        serialize::read(*in.rdbuf(), m_resolution);
+        serialize::read(*in.rdbuf(), m_cell_size);
+        serialize::read(*in.rdbuf(), m_inv_cell_size);
+        serialize::read(*in.rdbuf(), m_n_cells);
+        serialize::read(*in.rdbuf(), m_n_fields);
+        serialize::read(*in.rdbuf(), m_tolerance);
+        serialize::read(*in.rdbuf(), m_max_depth);
+        serialize::read(*in.rdbuf(), m_max_degree);
+
+        m_fields.assign(m_n_fields, {});
+        for (auto &field : m_fields)
+        {
+            auto n_nodes = std::size_t{};
+            auto n_coefficients = std::size_t{};
+            serialize::read(*in.rdbuf(), n_nodes);
+            serialize::read(*in.rdbuf(), n_coefficients);
+            field.nodes.resize(n_nodes);
+            field.coefficients.resize(n_coefficients);
+            serialize::readArray(*in.rdbuf(), field.nodes.data(), field.nodes.size());
+            serialize::readArray(*in.rdbuf(), field.coefficients.data(), field.coefficients.size());
+        }
+
+        in.close();
+    }
+
+    unsigned int
+    AdaptiveDiscreteGrid::addFunction(ContinuousFunction const &func, bool verbose,
+                                      SamplePredicate const &pred)
+    {
+        using namespace std::chrono;
+
+        auto t0_construction = high_resolution_clock::now();
+
+        auto build = LeafBuilder(func, m_max_degree);
+        auto n_roots = static_cast<int>(m_n_cells);
+        auto trees = std::vector<Tree>(m_n_cells);
+        ProgressReporter progress(m_n_cells, verbose, m_progress_callback);
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int r = 0; r < n_roots; ++r)
+        {
+            auto &tree = trees[r];
+            tree.child.push_back(no_child);
+            tree.degree.push_back(0u);
+            tree.offset.push_back(0u);
+
+            // Leaves to be processed together with their node index in the tree.
+            auto stack = std::vector<std::pair<Leaf, std::uint32_t>>{};
+            stack.emplace_back(build(subdomain(static_cast<unsigned int>(r)), 0u, initial_degree), 0u);
+            while (!stack.empty())
+            {
+                auto leaf = std::move(stack.back().first);
+                auto node = stack.back().second;
+                stack.pop_back();
+
+                auto refine = leaf.error > m_tolerance && (!pred || pred(leaf.box.center()));
+                auto can_p = refine && leaf.degree < m_max_degree;
+                auto can_h = refine && leaf.depth < m_max_depth;
+
+                // Candidates of both refinement types, compared by error reduction per added coefficient.
+                auto p_leaf = Leaf{};
+                auto p_gain = -std::numeric_limits<double>::infinity();
+                if (can_p)
+                {
+                    p_leaf = build(leaf.box, leaf.depth, leaf.degree + 1u);
+                    auto added = std::pow(leaf.degree + 2.0, 3) - std::pow(leaf.degree + 1.0, 3);
+                    p_gain = (leaf.error - p_leaf.error) / added;
+                }
+
+                auto h_leaves = std::vector<Leaf>{};
+                auto h_gain = -std::numeric_limits<double>::infinity();
+                if (can_h)
+                {
+                    auto error = 0.0;
+                    for (auto c = 0u; c < 8u; ++c)
+                    {
+                        h_leaves.push_back(build(childBox(leaf.box, c), leaf.depth + 1u, leaf.degree));
+                        error += h_leaves.back().error * h_leaves.back().error;
+                    }
+                    auto added = 7.0 * std::pow(leaf.degree + 1.0, 3);
+                    h_gain = (leaf.error - std::sqrt(error / 8.0)) / added;
+                }
+
+                if (can_h && (!can_p || h_gain >= p_gain))
+                {
+                    auto first = static_cast<std::uint32_t>(tree.child.size());
+                    tree.child[node] = first;
+                    tree.child.resize(first + 8u, no_child);
+                    tree.degree.resize(first + 8u, 0u);
+                    tree.offset.resize(first + 8u, 0u);
+                    for (auto c = 0u; c < 8u; ++c)
+                        stack.emplace_back(std::move(h_leaves[c]), first + c);
+                }
+                else if (can_p)
+                {
+                    stack.emplace_back(std::move(p_leaf), node);
+                }
+                else
+                {
+                    tree.degree[node] = leaf.degree;
+                    tree.offset[node] = static_cast<std::uint32_t>(tree.coefficients.size());
+                    tree.coefficients.insert(tree.coefficients.end(), leaf.coefficients.begin(), leaf.coefficients.end());
+                }
+            }
+
+            progress.add(1u);
+        }
+        progress.finish();
+
+        // The roots come first, followed by the remaining nodes of each tree.
+        auto node_base = std::vector<std::size_t>(m_n_cells + 1u);
+        auto coefficient_base = std::vector<std::size_t>(m_n_cells + 1u);
+        node_base[0] = m_n_cells;
+        for (auto r = 0u; r < m_n_cells; ++r)
+        {
+            node_base[r + 1] = node_base[r] + trees[r].child.size() - 1u;
+            coefficient_base[r + 1] = coefficient_base[r] + trees[r].coefficients.size();
+        }
+
+        m_fields.push_back({});
+        auto &field = m_fields.back();
+        field.nodes.resize(node_base[m_n_cells]);
+        field.coefficients.resize(coefficient_base[m_n_cells]);
+
+#pragma omp parallel for schedule(static)
+        for (int r = 0; r < n_roots; ++r)
+        {
+            auto const &tree = trees[r];
+            auto global = [&](std::uint32_t l)
+            {
+                return static_cast<std::uint32_t>(l == 0u ? r : node_base[r] + l - 1u);
+            };
+            for (auto l = 0u; l < tree.child.size(); ++l)
+            {
+                auto &node = field.nodes[global(l)];
+                node.child = tree.child[l] == no_child ? no_child : global(tree.child[l]);
+                node.degree = tree.degree[l];
+                node.offset = static_cast<std::uint32_t>(coefficient_base[r] + tree.offset[l]);
+            }
+            std::copy(tree.coefficients.begin(), tree.coefficients.end(), field.coefficients.begin() + coefficient_base[r]);
+        }
+
+        if (verbose)
+        {
+            std::cout << "\rConstruction took " << std::setw(15) << static_cast<float>(duration_cast<milliseconds>(high_resolution_clock::now() - t0_construction).count()) / 1000.0 << "s"
+                      << " (" << nLeaves(static_cast<unsigned int>(m_n_fields)) << " leaves, " << field.coefficients.size() << " coefficients)" << std::endl;
+        }
+
+        return static_cast<unsigned int>(m_n_fields++);
+    }
+
+    bool
+    AdaptiveDiscreteGrid::locateLeaf(Field const &field, Vector3f const &x, Node const *&leaf,
+                                     Vector3f &xi, Vector3f &c0) const
+    {
+        if (!m_domain.contains(x))
+            return false;
+
+        auto mi = (x - m_domain.min()).cwiseProduct(m_inv_cell_size).cast<unsigned int>().eval();
+        for (auto d = 0u; d < 3u; ++d)
+        {
+            if (mi[d] >= m_resolution[d])
+                mi[d] = m_resolution[d] - 1;
+        }
+
+        auto i = multiToSingleIndex({{mi(0), mi(1), mi(2)}});
+        auto sd = subdomain(i);
+        c0 = Vector3f::Constant(2.0).cwiseQuotient(sd.diagonal());
+        xi = c0.cwiseProduct(x - sd.center());
+
+        // Descend into the child containing xi and rescale [-1, 0] or [0, 1] to [-1, 1].
+        leaf = &field.nodes[i];
+        while (leaf->child != no_child)
+        {
+            auto c = 0u;
+            for (auto d = 0u; d < 3u; ++d)
+            {
+                if (xi[d] > 0.0f)
+                {
+                    c |= 1u << d;
+                    xi[d] = 2.0f * xi[d] - 1.0f;
+                }
+                else
+                {
+                    xi[d] = 2.0f * xi[d] + 1.0f;
+                }
+            }
+            c0 *= 2.0f;
+            leaf = &field.nodes[leaf->child + c];
+        }
+        return true;
+    }
+
+    float
+    AdaptiveDiscreteGrid::interpolate(unsigned int field_id, Vector3f const &x, Vector3f *gradient) const
+    {
+        auto const &field = m_fields[field_id];
+        Node const *leaf = nullptr;
+        auto xi = Vector3f{};
+        auto c0 = Vector3f{};
+        if (!locateLeaf(field, x, leaf, xi, c0))
+            return std::numeric_limits<float>::max();
+
+        auto p = leaf->degree;
+        auto p1 = p + 1u;
+        float P[3][max_degree_limit + 1u], dP[3][max_degree_limit + 1u];
+        for (auto d = 0u; d < 3u; ++d)
+            legendre(p, xi[d], P[d], gradient ? dP[d] : nullptr);
+
+        auto c = &field.coefficients[leaf->offset];
+        auto phi = 0.0f;
+        auto g = Vector3f{0.0f, 0.0f, 0.0f};
+        for (auto k = 0u; k < p1; ++k)
+            for (auto j = 0u; j < p1; ++j)
+            {
+                auto s = 0.0f, ds = 0.0f;
+                for (auto i = 0u; i < p1; ++i, ++c)
+                {
+                    s += *c * P[0][i];
+                    if (gradient)
+                        ds += *c * dP[0][i];
+                }
+                phi += s * P[1][j] * P[2][k];
+                if (gradient)
+                {
+                    g[0] += ds * P[1][j] * P[2][k];
+                    g[1] += s * dP[1][j] * P[2][k];
+                    g[2] += s * P[1][j] * dP[2][k];
+                }
+            }
+
+        if (gradient)
+            *gradient = g.cwiseProduct(c0);
+        return phi;
+    }
+
+    bool
+    AdaptiveDiscreteGrid::determineShapeFunctions(unsigned int, Vector3f const &,
+                                                  std::array<unsigned int, 32> &, Vector3f &, Matrix<float, 32, 1> &,
+                                                  Matrix<float, 32, 3> *) const
+    {
+        return false;
+    }
+
+    float
+    AdaptiveDiscreteGrid::interpolate(unsigned int, Vector3f const &, const std::array<unsigned int, 32> &, const Vector3f &,
+                                      const Matrix<float, 32, 1> &, Vector3f *gradient, Matrix<float, 32, 3> *) const
+    {
+        if (gradient)
+            gradient->setZero();
+        return std::numeric_limits<float>::max();
+    }
+
+    std::size_t
+    AdaptiveDiscreteGrid::nLeaves(unsigned int field_id) const
+    {
+        auto const &nodes = m_fields[field_id].nodes;
+        return static_cast<std::size_t>(std::count_if(nodes.begin(), nodes.end(), [](Node const &n)
+                                                      { return n.child == no_child; }));
+    }
+
+    std::size_t
+    AdaptiveDiscreteGrid::nCoefficients(unsigned int field_id) const
+    {
+        return m_fields[field_id].coefficients.size();
+    }
+
+} // namespace Discregrid
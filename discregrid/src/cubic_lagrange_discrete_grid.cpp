@@ -1,16 +1,24 @@
 #include "cubic_lagrange_discrete_grid.hpp"
-#include "data/z_sort_table.hpp"
-#include "utility/spinlock.hpp"
+#include "cubic_lagrange_shape_functions.hpp"
+#include "data/morton.hpp"
+#include "data/radix_sort.hpp"
+#include "simd/shape_functions.hpp"
+#include "utility/mapped_file.hpp"
+#include "utility/parallel_scan.hpp"
+#include "utility/progress.hpp"
 #include "utility/timing.hpp"
 #include <utility/serialize.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
-#include <future>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <numeric>
-#include <set>
 
 using namespace Eigen;
 
@@ -106,21 +114,21 @@ namespace Discregrid
             auto y2 = y * y;
             auto z2 = z * z;
 
-            auto _1mx = 1.0 - x;
-            auto _1my = 1.0 - y;
-            auto _1mz = 1.0 - z;
+            auto _1mx = 1.0f - x;
+            auto _1my = 1.0f - y;
+            auto _1mz = 1.0f - z;
 
-            auto _1px = 1.0 + x;
-            auto _1py = 1.0 + y;
-            auto _1pz = 1.0 + z;
+            auto _1px = 1.0f + x;
+            auto _1py = 1.0f + y;
+            auto _1pz = 1.0f + z;
 
-            auto _1m3x = 1.0 - 3.0 * x;
-            auto _1m3y = 1.0 - 3.0 * y;
-            auto _1m3z = 1.0 - 3.0 * z;
+            auto _1m3x = 1.0f - 3.0f * x;
+            auto _1m3y = 1.0f - 3.0f * y;
+            auto _1m3z = 1.0f - 3.0f * z;
 
-            auto _1p3x = 1.0 + 3.0 * x;
-            auto _1p3y = 1.0 + 3.0 * y;
-            auto _1p3z = 1.0 + 3.0 * z;
+            auto _1p3x = 1.0f + 3.0f * x;
+            auto _1p3y = 1.0f + 3.0f * y;
+            auto _1p3z = 1.0f + 3.0f * z;
 
             auto _1mxt1my = _1mx * _1my;
             auto _1mxt1py = _1mx * _1py;
@@ -137,12 +145,12 @@ namespace Discregrid
             auto _1pyt1mz = _1py * _1mz;
             auto _1pyt1pz = _1py * _1pz;
 
-            auto _1mx2 = 1.0 - x2;
-            auto _1my2 = 1.0 - y2;
-            auto _1mz2 = 1.0 - z2;
+            auto _1mx2 = 1.0f - x2;
+            auto _1my2 = 1.0f - y2;
+            auto _1mz2 = 1.0f - z2;
 
             // Corner nodes.
-            auto fac = 1.0 / 64.0 * (9.0 * (x2 + y2 + z2) - 19.0);
+            auto fac = 1.0f / 64.0f * (9.0f * (x2 + y2 + z2) - 19.0f);
             res[0] = fac * _1mxt1my * _1mz;
             res[1] = fac * _1mxt1my * _1pz;
             res[2] = fac * _1mxt1py * _1mz;
@@ -154,7 +162,7 @@ namespace Discregrid
 
             // Edge nodes.
 
-            fac = 9.0 / 64.0 * _1mx2;
+            fac = 9.0f / 64.0f * _1mx2;
             auto fact1m3x = fac * _1m3x;
             auto fact1p3x = fac * _1p3x;
             res[8] = fact1m3x * _1myt1mz;
@@ -166,7 +174,7 @@ namespace Discregrid
             res[14] = fact1p3x * _1pyt1mz;
             res[15] = fact1p3x * _1pyt1pz;
 
-            fac = 9.0 / 64.0 * _1my2;
+            fac = 9.0f / 64.0f * _1my2;
             auto fact1m3y = fac * _1m3y;
             auto fact1p3y = fac * _1p3y;
             res[16] = fact1m3y * _1mxt1mz;
@@ -178,7 +186,7 @@ namespace Discregrid
             res[22] = fact1p3y * _1pxt1mz;
             res[23] = fact1p3y * _1pxt1pz;
 
-            fac = 9.0 / 64.0 * _1mz2;
+            fac = 9.0f / 64.0f * _1mz2;
             auto fact1m3z = fac * _1m3z;
             auto fact1p3z = fac * _1p3z;
             res[24] = fact1m3z * _1mxt1my;
@@ -194,20 +202,20 @@ namespace Discregrid
             {
                 auto &dN = *gradient;
 
-                auto _9t3x2py2pz2m19 = 9.0 * (3.0 * x2 + y2 + z2) - 19.0;
-                auto _9tx2p3y2pz2m19 = 9.0 * (x2 + 3.0 * y2 + z2) - 19.0;
-                auto _9tx2py2p3z2m19 = 9.0 * (x2 + y2 + 3.0 * z2) - 19.0;
-                auto _18x = 18.0 * x;
-                auto _18y = 18.0 * y;
-                auto _18z = 18.0 * z;
+                auto _9t3x2py2pz2m19 = 9.0f * (3.0f * x2 + y2 + z2) - 19.0f;
+                auto _9tx2p3y2pz2m19 = 9.0f * (x2 + 3.0f * y2 + z2) - 19.0f;
+                auto _9tx2py2p3z2m19 = 9.0f * (x2 + y2 + 3.0f * z2) - 19.0f;
+                auto _18x = 18.0f * x;
+                auto _18y = 18.0f * y;
+                auto _18z = 18.0f * z;
 
-                auto _3m9x2 = 3.0 - 9.0 * x2;
-                auto _3m9y2 = 3.0 - 9.0 * y2;
-                auto _3m9z2 = 3.0 - 9.0 * z2;
+                auto _3m9x2 = 3.0f - 9.0f * x2;
+                auto _3m9y2 = 3.0f - 9.0f * y2;
+                auto _3m9z2 = 3.0f - 9.0f * z2;
 
-                auto _2x = 2.0 * x;
-                auto _2y = 2.0 * y;
-                auto _2z = 2.0 * z;
+                auto _2x = 2.0f * x;
+                auto _2y = 2.0f * y;
+                auto _2z = 2.0f * z;
 
                 auto _18xm9t3x2py2pz2m19 = _18x - _9t3x2py2pz2m19;
                 auto _18xp9t3x2py2pz2m19 = _18x + _9t3x2py2pz2m19;
@@ -241,7 +249,7 @@ namespace Discregrid
                 dN(7, 1) = _1pxt1pz * _18yp9tx2p3y2pz2m19;
                 dN(7, 2) = _1pxt1py * _18zp9tx2py2p3z2m19;
 
-                dN.topRows(8) /= 64.0;
+                dN.topRows(8) /= 64.0f;
 
                 auto _m3m9x2m2x = -_3m9x2 - _2x;
                 auto _p3m9x2m2x = _3m9x2 - _2x;
@@ -330,7 +338,7 @@ namespace Discregrid
                        dN(31, 1) = _1mz2t1p3z * _1px,
                        dN(31, 2) = _p3m9z2m2z * _1pxt1py;
 
-                dN.bottomRows(32u - 8u) *= 9.0 / 64.0;
+                dN.bottomRows(32u - 8u) *= 9.0f / 64.0f;
             }
 
             return res;
@@ -349,21 +357,21 @@ namespace Discregrid
             auto y2 = y * y;
             auto z2 = z * z;
 
-            auto _1mx = 1.0 - x;
-            auto _1my = 1.0 - y;
-            auto _1mz = 1.0 - z;
+            auto _1mx = 1.0f - x;
+            auto _1my = 1.0f - y;
+            auto _1mz = 1.0f - z;
 
-            auto _1px = 1.0 + x;
-            auto _1py = 1.0 + y;
-            auto _1pz = 1.0 + z;
+            auto _1px = 1.0f + x;
+            auto _1py = 1.0f + y;
+            auto _1pz = 1.0f + z;
 
-            auto _1m3x = 1.0 - 3.0 * x;
-            auto _1m3y = 1.0 - 3.0 * y;
-            auto _1m3z = 1.0 - 3.0 * z;
+            auto _1m3x = 1.0f - 3.0f * x;
+            auto _1m3y = 1.0f - 3.0f * y;
+            auto _1m3z = 1.0f - 3.0f * z;
 
-            auto _1p3x = 1.0 + 3.0 * x;
-            auto _1p3y = 1.0 + 3.0 * y;
-            auto _1p3z = 1.0 + 3.0 * z;
+            auto _1p3x = 1.0f + 3.0f * x;
+            auto _1p3y = 1.0f + 3.0f * y;
+            auto _1p3z = 1.0f + 3.0f * z;
 
             auto _1mxt1my = _1mx * _1my;
             auto _1mxt1py = _1mx * _1py;
@@ -380,12 +388,12 @@ namespace Discregrid
             auto _1pyt1mz = _1py * _1mz;
             auto _1pyt1pz = _1py * _1pz;
 
-            auto _1mx2 = 1.0 - x2;
-            auto _1my2 = 1.0 - y2;
-            auto _1mz2 = 1.0 - z2;
+            auto _1mx2 = 1.0f - x2;
+            auto _1my2 = 1.0f - y2;
+            auto _1mz2 = 1.0f - z2;
 
             // Corner nodes.
-            auto fac = 1.0 / 64.0 * (9.0 * (x2 + y2 + z2) - 19.0);
+            auto fac = 1.0f / 64.0f * (9.0f * (x2 + y2 + z2) - 19.0f);
             res[0] = fac * _1mxt1my * _1mz;
             res[1] = fac * _1pxt1my * _1mz;
             res[2] = fac * _1mxt1py * _1mz;
@@ -397,7 +405,7 @@ namespace Discregrid
 
             // Edge nodes.
 
-            fac = 9.0 / 64.0 * _1mx2;
+            fac = 9.0f / 64.0f * _1mx2;
             auto fact1m3x = fac * _1m3x;
             auto fact1p3x = fac * _1p3x;
             res[8] = fact1m3x * _1myt1mz;
@@ -409,7 +417,7 @@ namespace Discregrid
             res[14] = fact1m3x * _1pyt1pz;
             res[15] = fact1p3x * _1pyt1pz;
 
-            fac = 9.0 / 64.0 * _1my2;
+            fac = 9.0f / 64.0f * _1my2;
             auto fact1m3y = fac * _1m3y;
             auto fact1p3y = fac * _1p3y;
             res[16] = fact1m3y * _1mxt1mz;
@@ -421,7 +429,7 @@ namespace Discregrid
             res[22] = fact1m3y * _1pxt1pz;
             res[23] = fact1p3y * _1pxt1pz;
 
-            fac = 9.0 / 64.0 * _1mz2;
+            fac = 9.0f / 64.0f * _1mz2;
             auto fact1m3z = fac * _1m3z;
             auto fact1p3z = fac * _1p3z;
             res[24] = fact1m3z * _1mxt1my;
@@ -437,20 +445,20 @@ namespace Discregrid
             {
                 auto &dN = *gradient;
 
-                auto _9t3x2py2pz2m19 = 9.0 * (3.0 * x2 + y2 + z2) - 19.0;
-                auto _9tx2p3y2pz2m19 = 9.0 * (x2 + 3.0 * y2 + z2) - 19.0;
-                auto _9tx2py2p3z2m19 = 9.0 * (x2 + y2 + 3.0 * z2) - 19.0;
-                auto _18x = 18.0 * x;
-                auto _18y = 18.0 * y;
-                auto _18z = 18.0 * z;
+                auto _9t3x2py2pz2m19 = 9.0f * (3.0f * x2 + y2 + z2) - 19.0f;
+                auto _9tx2p3y2pz2m19 = 9.0f * (x2 + 3.0f * y2 + z2) - 19.0f;
+                auto _9tx2py2p3z2m19 = 9.0f * (x2 + y2 + 3.0f * z2) - 19.0f;
+                auto _18x = 18.0f * x;
+                auto _18y = 18.0f * y;
+                auto _18z = 18.0f * z;
 
-                auto _3m9x2 = 3.0 - 9.0 * x2;
-                auto _3m9y2 = 3.0 - 9.0 * y2;
-                auto _3m9z2 = 3.0 - 9.0 * z2;
+                auto _3m9x2 = 3.0f - 9.0f * x2;
+                auto _3m9y2 = 3.0f - 9.0f * y2;
+                auto _3m9z2 = 3.0f - 9.0f * z2;
 
-                auto _2x = 2.0 * x;
-                auto _2y = 2.0 * y;
-                auto _2z = 2.0 * z;
+                auto _2x = 2.0f * x;
+                auto _2y = 2.0f * y;
+                auto _2z = 2.0f * z;
 
                 auto _18xm9t3x2py2pz2m19 = _18x - _9t3x2py2pz2m19;
                 auto _18xp9t3x2py2pz2m19 = _18x + _9t3x2py2pz2m19;
@@ -484,7 +492,7 @@ namespace Discregrid
                 dN(7, 1) = _1pxt1pz * _18yp9tx2p3y2pz2m19;
                 dN(7, 2) = _1pxt1py * _18zp9tx2py2p3z2m19;
 
-                dN.topRows(8) /= 64.0;
+                dN.topRows(8) /= 64.0f;
 
                 auto _m3m9x2m2x = -_3m9x2 - _2x;
                 auto _p3m9x2m2x = _3m9x2 - _2x;
@@ -573,34 +581,164 @@ namespace Discregrid
                        dN(31, 1) = _1mz2t1p3z * _1px,
                        dN(31, 2) = _p3m9z2m2z * _1pxt1py;
 
-                dN.bottomRows(32u - 8u) *= 9.0 / 64.0;
+                dN.bottomRows(32u - 8u) *= 9.0f / 64.0f;
             }
 
             return res;
         }
 
-        // Determines Morten value according to z-curve.
+        // Determines Morten value according to z-curve. The keys are taken relative to the domain
+        // origin such that they are small and non-negative, which lets the radix sort skip the
+        // passes over the constant high bits.
         inline uint64_t
-        zValue(Vector3f const &x, float invCellSize)
+        zValue(MortonEncoder encode, Vector3f const &x, Vector3f const &origin, float invCellSize)
         {
-            std::array<int, 3> key;
+            std::array<unsigned int, 3> p;
             for (unsigned int i(0); i < 3; ++i)
+                p[i] = static_cast<unsigned int>(std::max(0.0f, invCellSize * (x[i] - origin[i])));
+
+            return encode(p);
+        }
+
+        // Gathers the coefficients of a cell from the nodes it references.
+        inline void
+        gather(float const *nodes, std::array<unsigned int, 32> const &cell, float *c)
+        {
+            for (auto j = 0u; j < 32u; ++j)
+                c[j] = nodes[cell[j]];
+        }
+
+        // Bricked node order: every grid vertex owns 7 consecutive entries, its own node followed by
+        // the two inner nodes of its edges in positive x-, y- and z-direction. The vertex lattice is
+        // padded to a multiple of brick_size in each direction and stored brick by brick in
+        // lexicographic order, the vertices of a brick along a z-curve.
+        unsigned int const brick_size = 4u;
+        unsigned int const brick_vertices = brick_size * brick_size * brick_size;
+        unsigned int const vertex_slots = 7u;
+
+        inline std::array<unsigned int, 3>
+        nBricks(std::array<unsigned int, 3> const &resolution)
+        {
+            return {{(resolution[0] + brick_size) / brick_size,
+                     (resolution[1] + brick_size) / brick_size,
+                     (resolution[2] + brick_size) / brick_size}};
+        }
+
+        // Number of nodes of a dense field of a grid with the given resolution in the given order.
+        inline std::size_t
+        nodeCount(std::array<unsigned int, 3> const &resolution, CubicLagrangeDiscreteGrid::NodeOrder order)
+        {
+            auto n = Matrix<std::size_t, 3, 1>{resolution[0], resolution[1], resolution[2]};
+            if (order == CubicLagrangeDiscreteGrid::NodeOrder::Bricked)
             {
-                if (x[i] >= 0.0)
-                    key[i] = static_cast<int>(invCellSize * x[i]);
-                else
-                    key[i] = static_cast<int>(invCellSize * x[i]) - 1;
+                auto nb = nBricks(resolution);
+                return std::size_t{vertex_slots} * brick_vertices * nb[0] * nb[1] * nb[2];
             }
 
-            std::array<unsigned int, 3> p = {
-                static_cast<unsigned int>(static_cast<int64_t>(key[0]) - (std::numeric_limits<int>::lowest() + 1)),
-                static_cast<unsigned int>(static_cast<int64_t>(key[1]) - (std::numeric_limits<int>::lowest() + 1)),
-                static_cast<unsigned int>(static_cast<int64_t>(key[2]) - (std::numeric_limits<int>::lowest() + 1))};
+            auto nv = (n[0] + 1) * (n[1] + 1) * (n[2] + 1);
+            auto ne = n[0] * (n[1] + 1) * (n[2] + 1) + (n[0] + 1) * n[1] * (n[2] + 1) + (n[0] + 1) * (n[1] + 1) * n[2];
+            return nv + 2 * ne;
+        }
+
+        // Index of the first entry owned by vertex (i, j, k) in the bricked order.
+        inline unsigned int
+        brickedVertex(std::array<unsigned int, 3> const &nb, unsigned int i, unsigned int j, unsigned int k)
+        {
+            auto brick = (nb[1] * (k / brick_size) + j / brick_size) * nb[0] + i / brick_size;
+            auto a = i % brick_size, b = j % brick_size, c = k % brick_size;
+            auto z = (a & 1u) | (b & 1u) << 1 | (c & 1u) << 2 | (a & 2u) << 2 | (b & 2u) << 3 | (c & 2u) << 4;
+            return vertex_slots * (brick_vertices * brick + z);
+        }
+
+        // Versioned format written by saveMappable. All arrays start at offsets from the beginning of
+        // the file that are multiples of mappable_alignment, so that they can be used in place.
+        // Version 2 allows dense fields without cells and cell map, denoted by zero offsets.
+        // Version 3 adds the node order of dense fields.
+        char const mappable_magic[8] = {'D', 'S', 'C', 'R', 'G', 'R', 'I', 'D'};
+        std::uint32_t const mappable_version = 3u;
+        std::uint64_t const mappable_alignment = 64u;
+
+        struct MappableHeader
+        {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t resolution[3];
+            float domain_min[3];
+            float domain_max[3];
+            float cell_size[3];
+            float inv_cell_size[3];
+            std::uint64_t n_cells;
+            std::uint64_t n_fields;
+        };
+
+        // Followed by n_cells (grid) cell map entries and (n_cells + 31) / 32 validity words.
+        struct MappableField
+        {
+            std::uint64_t n_nodes;
+            std::uint64_t nodes_offset;
+            std::uint64_t n_cells;
+            std::uint64_t cells_offset;
+            std::uint64_t cell_map_offset;
+            std::uint64_t cell_valid_offset;
+            std::uint64_t node_order;
+        };
+
+        // Size of a field table entry in files of the given version.
+        inline std::uint64_t
+        mappableFieldSize(std::uint32_t version)
+        {
+            return version >= 3u ? sizeof(MappableField) : offsetof(MappableField, node_order);
+        }
+
+        inline std::uint64_t
+        alignOffset(std::uint64_t offset)
+        {
+            return (offset + mappable_alignment - 1u) / mappable_alignment * mappable_alignment;
+        }
+
+        inline std::size_t
+        nValidityWords(std::size_t n_cells)
+        {
+            return (n_cells + 31u) / 32u;
+        }
+
+        // Returns true if the number of cells of a header matches its resolution, the node indices of
+        // which fit into 32 bits, and if its cell sizes match its domain.
+        inline bool
+        consistent(MappableHeader const &header)
+        {
+            auto resolution = std::array<unsigned int, 3>{{header.resolution[0], header.resolution[1], header.resolution[2]}};
+            auto n_cells = std::uint64_t{1u};
+            for (auto d = 0u; d < 3u; ++d)
+            {
+                if (resolution[d] == 0u || resolution[d] > 1u << 20)
+                    return false;
+                n_cells *= resolution[d];
+            }
+            if (header.n_cells != n_cells ||
+                nodeCount(resolution, CubicLagrangeDiscreteGrid::NodeOrder::Bricked) > std::numeric_limits<unsigned int>::max() ||
+                nodeCount(resolution, CubicLagrangeDiscreteGrid::NodeOrder::Lexicographic) > std::numeric_limits<unsigned int>::max())
+                return false;
 
-            return morton_lut(p);
+            auto const tolerance = 1.0e-5f;
+            for (auto d = 0u; d < 3u; ++d)
+            {
+                auto cell_size = (header.domain_max[d] - header.domain_min[d]) / static_cast<float>(resolution[d]);
+                if (!(cell_size > 0.0f && std::isfinite(cell_size) &&
+                      std::abs(header.cell_size[d] - cell_size) <= tolerance * cell_size &&
+                      std::abs(header.inv_cell_size[d] * cell_size - 1.0f) <= tolerance))
+                    return false;
+            }
+            return true;
         }
     } // namespace
 
+    Matrix<float, 32, 1>
+    cubicLagrangeShapeFunctions(Vector3f const &xi, Matrix<float, 32, 3> *gradient)
+    {
+        return shape_function_(xi, gradient);
+    }
+
     Vector3f
     CubicLagrangeDiscreteGrid::indexToNodePosition(unsigned int l) const
     {
@@ -664,6 +802,247 @@ namespace Discregrid
         return x;
     }
 
+    std::size_t
+    CubicLagrangeDiscreteGrid::nNodes(NodeOrder order) const
+    {
+        return nodeCount(m_resolution, order);
+    }
+
+    bool
+    CubicLagrangeDiscreteGrid::nodePosition(unsigned int l, NodeOrder order, Vector3f &x) const
+    {
+        if (order == NodeOrder::Lexicographic)
+        {
+            x = indexToNodePosition(l);
+            return true;
+        }
+
+        auto nb = nBricks(m_resolution);
+        auto slot = l % vertex_slots;
+        auto brick = l / vertex_slots / brick_vertices;
+        auto z = l / vertex_slots % brick_vertices;
+        auto ijk = Matrix<unsigned int, 3, 1>{
+            brick_size * (brick % nb[0]) + ((z & 1u) | (z >> 2 & 2u)),
+            brick_size * (brick / nb[0] % nb[1]) + ((z >> 1 & 1u) | (z >> 3 & 2u)),
+            brick_size * (brick / nb[0] / nb[1]) + ((z >> 2 & 1u) | (z >> 4 & 2u))};
+
+        // Edges in direction d do not exist beyond the last vertex in direction d.
+        for (auto d = 0u; d < 3u; ++d)
+        {
+            if (ijk[d] > m_resolution[d] || (slot > 0u && (slot - 1u) / 2u == d && ijk[d] == m_resolution[d]))
+                return false;
+        }
+
+        x = m_domain.min() + m_cell_size.cwiseProduct(ijk.cast<float>());
+        if (slot > 0u)
+        {
+            auto d = (slot - 1u) / 2u;
+            x(d) += (1.0 + static_cast<float>((slot - 1u) % 2u)) / 3.0 * m_cell_size[d];
+        }
+        return true;
+    }
+
+    std::array<unsigned int, 7>
+    CubicLagrangeDiscreteGrid::vertexNodes(unsigned int i, unsigned int j, unsigned int k, NodeOrder order) const
+    {
+        auto nx = m_resolution[0];
+        auto ny = m_resolution[1];
+        auto nz = m_resolution[2];
+
+        auto nodes = std::array<unsigned int, 7>{};
+        nodes.fill(std::numeric_limits<unsigned int>::max());
+        if (order == NodeOrder::Bricked)
+        {
+            auto v = brickedVertex(nBricks(m_resolution), i, j, k);
+            nodes[0] = v;
+            for (auto s = 1u; s < 7u; ++s)
+            {
+                auto d = (s - 1u) / 2u;
+                if ((d == 0u && i < nx) || (d == 1u && j < ny) || (d == 2u && k < nz))
+                    nodes[s] = v + s;
+            }
+            return nodes;
+        }
+
+        auto nv = (nx + 1) * (ny + 1) * (nz + 1);
+        auto ne_x = nx * (ny + 1) * (nz + 1);
+        auto ne_y = (nx + 1) * ny * (nz + 1);
+
+        nodes[0] = (nx + 1) * (ny + 1) * k + (nx + 1) * j + i;
+        if (i < nx)
+        {
+            nodes[1] = nv + 2 * (nx * (ny + 1) * k + nx * j + i);
+            nodes[2] = nodes[1] + 1;
+        }
+        if (j < ny)
+        {
+            nodes[3] = nv + 2 * ne_x + 2 * (ny * (nz + 1) * i + ny * k + j);
+            nodes[4] = nodes[3] + 1;
+        }
+        if (k < nz)
+        {
+            nodes[5] = nv + 2 * (ne_x + ne_y) + 2 * (nz * (nx + 1) * j + nz * i + k);
+            nodes[6] = nodes[5] + 1;
+        }
+        return nodes;
+    }
+
+    std::array<unsigned int, 32>
+    CubicLagrangeDiscreteGrid::cellNodes(unsigned int l, NodeOrder order) const
+    {
+        auto nx = m_resolution[0];
+        auto ny = m_resolution[1];
+        auto nz = m_resolution[2];
+
+        auto k = l / (ny * nx);
+        auto temp = l % (ny * nx);
+        auto j = temp / nx;
+        auto i = temp % nx;
+
+        auto cell = std::array<unsigned int, 32>{};
+        if (order == NodeOrder::Bricked)
+        {
+            auto nb = nBricks(m_resolution);
+            auto v = [&](unsigned int a, unsigned int b, unsigned int c)
+            {
+                return brickedVertex(nb, a, b, c);
+            };
+
+            cell[0] = v(i, j, k);
+            cell[1] = v(i + 1, j, k);
+            cell[2] = v(i, j + 1, k);
+            cell[3] = v(i + 1, j + 1, k);
+            cell[4] = v(i, j, k + 1);
+            cell[5] = v(i + 1, j, k + 1);
+            cell[6] = v(i, j + 1, k + 1);
+            cell[7] = v(i + 1, j + 1, k + 1);
+
+            cell[8] = cell[0] + 1;
+            cell[10] = cell[4] + 1;
+            cell[12] = cell[2] + 1;
+            cell[14] = cell[6] + 1;
+
+            cell[16] = cell[0] + 3;
+            cell[18] = cell[1] + 3;
+            cell[20] = cell[4] + 3;
+            cell[22] = cell[5] + 3;
+
+            cell[24] = cell[0] + 5;
+            cell[26] = cell[2] + 5;
+            cell[28] = cell[1] + 5;
+            cell[30] = cell[3] + 5;
+
+            for (auto e = 8u; e < 32u; e += 2u)
+                cell[e + 1] = cell[e] + 1;
+            return cell;
+        }
+
+        auto nv = (nx + 1) * (ny + 1) * (nz + 1);
+        auto ne_x = nx * (ny + 1) * (nz + 1);
+        auto ne_y = (nx + 1) * ny * (nz + 1);
+
+        cell[0] = (nx + 1) * (ny + 1) * k + (nx + 1) * j + i;
+        cell[1] = (nx + 1) * (ny + 1) * k + (nx + 1) * j + i + 1;
+        cell[2] = (nx + 1) * (ny + 1) * k + (nx + 1) * (j + 1) + i;
+        cell[3] = (nx + 1) * (ny + 1) * k + (nx + 1) * (j + 1) + i + 1;
+        cell[4] = (nx + 1) * (ny + 1) * (k + 1) + (nx + 1) * j + i;
+        cell[5] = (nx + 1) * (ny + 1) * (k + 1) + (nx + 1) * j + i + 1;
+        cell[6] = (nx + 1) * (ny + 1) * (k + 1) + (nx + 1) * (j + 1) + i;
+        cell[7] = (nx + 1) * (ny + 1) * (k + 1) + (nx + 1) * (j + 1) + i + 1;
+
+        auto offset = nv;
+        cell[8] = offset + 2 * (nx * (ny + 1) * k + nx * j + i);
+        cell[9] = cell[8] + 1;
+        cell[10] = offset + 2 * (nx * (ny + 1) * (k + 1) + nx * j + i);
+        cell[11] = cell[10] + 1;
+        cell[12] = offset + 2 * (nx * (ny + 1) * k + nx * (j + 1) + i);
+        cell[13] = cell[12] + 1;
+        cell[14] = offset + 2 * (nx * (ny + 1) * (k + 1) + nx * (j + 1) + i);
+        cell[15] = cell[14] + 1;
+
+        offset += 2 * ne_x;
+        cell[16] = offset + 2 * (ny * (nz + 1) * i + ny * k + j);
+        cell[17] = cell[16] + 1;
+        cell[18] = offset + 2 * (ny * (nz + 1) * (i + 1) + ny * k + j);
+        cell[19] = cell[18] + 1;
+        cell[20] = offset + 2 * (ny * (nz + 1) * i + ny * (k + 1) + j);
+        cell[21] = cell[20] + 1;
+        cell[22] = offset + 2 * (ny * (nz + 1) * (i + 1) + ny * (k + 1) + j);
+        cell[23] = cell[22] + 1;
+
+        offset += 2 * ne_y;
+        cell[24] = offset + 2 * (nz * (nx + 1) * j + nz * i + k);
+        cell[25] = cell[24] + 1;
+        cell[26] = offset + 2 * (nz * (nx + 1) * (j + 1) + nz * i + k);
+        cell[27] = cell[26] + 1;
+        cell[28] = offset + 2 * (nz * (nx + 1) * j + nz * (i + 1) + k);
+        cell[29] = cell[28] + 1;
+        cell[30] = offset + 2 * (nz * (nx + 1) * (j + 1) + nz * (i + 1) + k);
+        cell[31] = cell[30] + 1;
+
+        return cell;
+    }
+
+    void
+    CubicLagrangeDiscreteGrid::gatherCell(FieldData const &fd, unsigned int cell_index, float *c) const
+    {
+        if (fd.cells)
+            gather(fd.nodes, fd.cells[cell_index], c);
+        else
+            gather(fd.nodes, cellNodes(cell_index, fd.node_order), c);
+    }
+
+    void
+    CubicLagrangeDiscreteGrid::makeConnectivityExplicit(unsigned int field_id)
+    {
+        auto &cell_map = m_cell_map[field_id];
+        if (!cell_map.empty())
+            return;
+
+        auto &cells = m_cells[field_id];
+        auto order = m_node_order[field_id];
+        cells.resize(m_n_cells);
+        cell_map.resize(m_n_cells);
+
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < static_cast<int>(m_n_cells); ++l)
+        {
+            cells[l] = cellNodes(l, order);
+            cell_map[l] = l;
+        }
+    }
+
+    void
+    CubicLagrangeDiscreteGrid::makeConnectivityImplicit(unsigned int field_id)
+    {
+        auto &cells = m_cells[field_id];
+        auto &cell_map = m_cell_map[field_id];
+        if (cell_map.empty() || cells.size() != m_n_cells)
+            return;
+
+        // The connectivity is implicit if it matches one of the node orders.
+        for (auto order : {NodeOrder::Lexicographic, NodeOrder::Bricked})
+        {
+            if (m_nodes[field_id].size() != nNodes(order))
+                continue;
+
+            auto dense = true;
+#pragma omp parallel for schedule(static) reduction(&& : dense)
+            for (int l = 0; l < static_cast<int>(m_n_cells); ++l)
+            {
+                dense = dense && cell_map[l] == static_cast<unsigned int>(l) && cells[l] == cellNodes(l, order);
+            }
+
+            if (dense)
+            {
+                cells = {};
+                cell_map = {};
+                m_node_order[field_id] = order;
+                return;
+            }
+        }
+    }
+
     CubicLagrangeDiscreteGrid::CubicLagrangeDiscreteGrid(std::string const &filename)
     {
         load(filename);
@@ -685,34 +1064,41 @@ namespace Discregrid
         serialize::write(*out.rdbuf(), m_n_cells);
         serialize::write(*out.rdbuf(), m_n_fields);
 
-        serialize::write(*out.rdbuf(), m_nodes.size());
-        for (auto const &nodes : m_nodes)
+        serialize::write(*out.rdbuf(), m_n_fields);
+        for (auto field_id = 0u; field_id < m_n_fields; ++field_id)
         {
-            serialize::write(*out.rdbuf(), nodes.size());
-            for (auto const &node : nodes)
-            {
-                serialize::write(*out.rdbuf(), node);
-            }
+            auto fd = fieldData(field_id);
+            serialize::write(*out.rdbuf(), fd.n_nodes);
+            serialize::writeArray(*out.rdbuf(), fd.nodes, fd.n_nodes);
         }
 
-        serialize::write(*out.rdbuf(), m_cells.size());
-        for (auto const &cells : m_cells)
+        // The legacy format stores the connectivity of dense fields explicitly.
+        serialize::write(*out.rdbuf(), m_n_fields);
+        for (auto field_id = 0u; field_id < m_n_fields; ++field_id)
         {
-            serialize::write(*out.rdbuf(), cells.size());
-            for (auto const &cell : cells)
+            auto fd = fieldData(field_id);
+            serialize::write(*out.rdbuf(), fd.n_cells);
+            if (fd.cells)
             {
-                serialize::write(*out.rdbuf(), cell);
+                serialize::writeArray(*out.rdbuf(), fd.cells, fd.n_cells);
+                continue;
             }
+            for (auto l = 0u; l < fd.n_cells; ++l)
+                serialize::write(*out.rdbuf(), cellNodes(l, fd.node_order));
         }
 
-        serialize::write(*out.rdbuf(), m_cell_map.size());
-        for (auto const &maps : m_cell_map)
+        serialize::write(*out.rdbuf(), m_n_fields);
+        for (auto field_id = 0u; field_id < m_n_fields; ++field_id)
         {
-            serialize::write(*out.rdbuf(), maps.size());
-            for (auto const &map : maps)
+            auto fd = fieldData(field_id);
+            serialize::write(*out.rdbuf(), m_n_cells);
+            if (fd.cell_map)
             {
-                serialize::write(*out.rdbuf(), map);
+                serialize::writeArray(*out.rdbuf(), fd.cell_map, m_n_cells);
+                continue;
             }
+            for (auto l = 0u; l < m_n_cells; ++l)
+                serialize::write(*out.rdbuf(), l);
         }
 
         out.close();
@@ -728,6 +1114,24 @@ namespace Discregrid
             return;
         }
 
+        // Files in the mappable format are mapped and copied into memory.
+        char magic[sizeof(mappable_magic)] = {};
+        in.read(magic, sizeof(magic));
+        if (in.gcount() == sizeof(magic) && std::memcmp(magic, mappable_magic, sizeof(magic)) == 0)
+        {
+            in.close();
+            if (mapFile(filename))
+            {
+                for (auto field_id = 0u; field_id < m_n_fields; ++field_id)
+                    detach(field_id);
+            }
+            return;
+        }
+        in.seekg(0);
+
+        m_mapping.reset();
+        m_mapped_fields.clear();
+
         serialize::read(*in.rdbuf(), m_domain);
         serialize::read(*in.rdbuf(), m_resolution);
         serialize::read(*in.rdbuf(), m_cell_size);
@@ -742,10 +1146,7 @@ namespace Discregrid
         {
             serialize::read(*in.rdbuf(), n_nodes);
             nodes.resize(n_nodes);
-            for (auto &node : nodes)
-            {
-                serialize::read(*in.rdbuf(), node);
-            }
+            serialize::readArray(*in.rdbuf(), nodes.data(), nodes.size());
         }
 
         auto n_cells = std::size_t{};
@@ -755,10 +1156,7 @@ namespace Discregrid
         {
             serialize::read(*in.rdbuf(), n_cells);
             cells.resize(n_cells);
-            for (auto &cell : cells)
-            {
-                serialize::read(*in.rdbuf(), cell);
-            }
+            serialize::readArray(*in.rdbuf(), cells.data(), cells.size());
         }
 
         auto n_cell_maps = std::size_t{};
@@ -768,128 +1166,389 @@ namespace Discregrid
         {
             serialize::read(*in.rdbuf(), n_cell_maps);
             cell_maps.resize(n_cell_maps);
-            for (auto &cell_map : cell_maps)
+            serialize::readArray(*in.rdbuf(), cell_maps.data(), cell_maps.size());
+        }
+
+        m_baked_cells.clear();
+        m_baked_cells.resize(m_nodes.size());
+        m_mapped_fields.resize(m_nodes.size());
+
+        m_cell_valid.resize(m_nodes.size());
+        m_node_order.assign(m_nodes.size(), NodeOrder::Lexicographic);
+        for (auto field_id = 0u; field_id < m_nodes.size(); ++field_id)
+        {
+            makeConnectivityImplicit(field_id);
+            updateCellValidity(field_id);
+        }
+
+        in.close();
+    }
+
+    void CubicLagrangeDiscreteGrid::saveMappable(std::string const &filename) const
+    {
+        auto header = MappableHeader{};
+        std::memcpy(header.magic, mappable_magic, sizeof(mappable_magic));
+        header.version = mappable_version;
+        for (auto d = 0u; d < 3u; ++d)
+        {
+            header.resolution[d] = m_resolution[d];
+            header.domain_min[d] = m_domain.min()[d];
+            header.domain_max[d] = m_domain.max()[d];
+            header.cell_size[d] = m_cell_size[d];
+            header.inv_cell_size[d] = m_inv_cell_size[d];
+        }
+        header.n_cells = m_n_cells;
+        header.n_fields = m_n_fields;
+
+        auto table = std::vector<MappableField>(m_n_fields);
+        auto offset = alignOffset(sizeof(MappableHeader) + table.size() * sizeof(MappableField));
+        for (auto field_id = 0u; field_id < m_n_fields; ++field_id)
+        {
+            auto fd = fieldData(field_id);
+            auto &entry = table[field_id];
+            entry.n_nodes = fd.n_nodes;
+            entry.nodes_offset = offset;
+            offset = alignOffset(offset + fd.n_nodes * sizeof(float));
+            entry.n_cells = fd.n_cells;
+            entry.cells_offset = 0u;
+            entry.cell_map_offset = 0u;
+            if (fd.cell_map)
             {
-                serialize::read(*in.rdbuf(), cell_map);
+                entry.cells_offset = offset;
+                offset = alignOffset(offset + fd.n_cells * sizeof(std::array<unsigned int, 32>));
+                entry.cell_map_offset = offset;
+                offset = alignOffset(offset + m_n_cells * sizeof(unsigned int));
             }
+            entry.cell_valid_offset = offset;
+            offset = alignOffset(offset + nValidityWords(fd.n_cells) * sizeof(std::uint32_t));
+            entry.node_order = static_cast<std::uint64_t>(fd.node_order);
         }
 
-        in.close();
+        auto out = std::ofstream(filename, std::ios::binary);
+        auto &buf = *out.rdbuf();
+        auto position = std::uint64_t{0u};
+        auto write = [&](void const *data, std::uint64_t offset, std::uint64_t bytes)
+        {
+            char const zeros[mappable_alignment] = {};
+            while (position < offset)
+            {
+                auto n = std::min(offset - position, mappable_alignment);
+                buf.sputn(zeros, static_cast<std::streamsize>(n));
+                position += n;
+            }
+            buf.sputn(static_cast<char const *>(data), static_cast<std::streamsize>(bytes));
+            position += bytes;
+        };
+
+        write(&header, 0u, sizeof(header));
+        write(table.data(), position, table.size() * sizeof(MappableField));
+        for (auto field_id = 0u; field_id < m_n_fields; ++field_id)
+        {
+            auto fd = fieldData(field_id);
+            auto const &entry = table[field_id];
+            write(fd.nodes, entry.nodes_offset, fd.n_nodes * sizeof(float));
+            if (fd.cell_map)
+            {
+                write(fd.cells, entry.cells_offset, fd.n_cells * sizeof(std::array<unsigned int, 32>));
+                write(fd.cell_map, entry.cell_map_offset, m_n_cells * sizeof(unsigned int));
+            }
+            write(fd.cell_valid, entry.cell_valid_offset, nValidityWords(fd.n_cells) * sizeof(std::uint32_t));
+        }
+        write(nullptr, offset, 0u);
+
+        out.close();
+    }
+
+    bool CubicLagrangeDiscreteGrid::mapFile(std::string const &filename)
+    {
+        auto mapping = std::make_shared<MappedFile const>(filename);
+        if (!mapping->isOpen())
+        {
+            std::cerr << "ERROR: Discrete grid can not be mapped. Input file does not exist!" << std::endl;
+            return false;
+        }
+
+        auto data = mapping->data();
+        auto size = static_cast<std::uint64_t>(mapping->size());
+        auto header = MappableHeader{};
+        if (size < sizeof(header))
+        {
+            std::cerr << "ERROR: Discrete grid can not be mapped. Input file is not in the mappable format!" << std::endl;
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, mappable_magic, sizeof(mappable_magic)) != 0 || header.version < 1u ||
+            header.version > mappable_version)
+        {
+            std::cerr << "ERROR: Discrete grid can not be mapped. Input file is not in the mappable format or of an unsupported version!" << std::endl;
+            return false;
+        }
+
+        if (!consistent(header))
+        {
+            std::cerr << "ERROR: Discrete grid can not be mapped. Input file contains an inconsistent grid!" << std::endl;
+            return false;
+        }
+        auto resolution = std::array<unsigned int, 3>{{header.resolution[0], header.resolution[1], header.resolution[2]}};
+
+        auto field_size = mappableFieldSize(header.version);
+        auto table_end = sizeof(MappableHeader) + header.n_fields * field_size;
+        if (header.n_fields > size / field_size || table_end > size)
+        {
+            std::cerr << "ERROR: Discrete grid can not be mapped. Input file is truncated!" << std::endl;
+            return false;
+        }
+
+        auto in_bounds = [&](std::uint64_t offset, std::uint64_t n, std::uint64_t element_size)
+        {
+            return offset % mappable_alignment == 0u && offset <= size && n <= (size - offset) / element_size;
+        };
+
+        auto fields = std::vector<FieldData>(header.n_fields);
+        auto node_order = std::vector<NodeOrder>(header.n_fields);
+        for (auto field_id = 0u; field_id < header.n_fields; ++field_id)
+        {
+            auto entry = MappableField{};
+            std::memcpy(&entry, data + sizeof(MappableHeader) + field_id * field_size, field_size);
+            auto dense = header.version >= 2u && entry.cells_offset == 0u && entry.cell_map_offset == 0u;
+            if (entry.node_order > static_cast<std::uint64_t>(NodeOrder::Bricked))
+            {
+                std::cerr << "ERROR: Discrete grid can not be mapped. Input file contains an unknown node order!" << std::endl;
+                return false;
+            }
+            node_order[field_id] = static_cast<NodeOrder>(entry.node_order);
+
+            if (dense && entry.n_nodes != nodeCount(resolution, node_order[field_id]))
+            {
+                std::cerr << "ERROR: Discrete grid can not be mapped. Input file contains an inconsistent grid!" << std::endl;
+                return false;
+            }
+            if (!in_bounds(entry.nodes_offset, entry.n_nodes, sizeof(float)) ||
+                (!dense && !in_bounds(entry.cells_offset, entry.n_cells, sizeof(std::array<unsigned int, 32>))) ||
+                (!dense && !in_bounds(entry.cell_map_offset, header.n_cells, sizeof(unsigned int))) ||
+                (dense && entry.n_cells != header.n_cells) ||
+                !in_bounds(entry.cell_valid_offset, nValidityWords(entry.n_cells), sizeof(std::uint32_t)))
+            {
+                std::cerr << "ERROR: Discrete grid can not be mapped. Input file is truncated!" << std::endl;
+                return false;
+            }
+
+            auto &fd = fields[field_id];
+            fd.nodes = reinterpret_cast<float const *>(data + entry.nodes_offset);
+            if (!dense)
+            {
+                fd.cells = reinterpret_cast<std::array<unsigned int, 32> const *>(data + entry.cells_offset);
+                fd.cell_map = reinterpret_cast<unsigned int const *>(data + entry.cell_map_offset);
+            }
+            fd.cell_valid = reinterpret_cast<std::uint32_t const *>(data + entry.cell_valid_offset);
+            fd.n_nodes = entry.n_nodes;
+            fd.n_cells = entry.n_cells;
+            fd.node_order = node_order[field_id];
+        }
+
+        m_domain = AlignedBox3f(Vector3f::Map(header.domain_min), Vector3f::Map(header.domain_max));
+        for (auto d = 0u; d < 3u; ++d)
+            m_resolution[d] = header.resolution[d];
+        m_cell_size = Vector3f::Map(header.cell_size);
+        m_inv_cell_size = Vector3f::Map(header.inv_cell_size);
+        m_n_cells = header.n_cells;
+        m_n_fields = header.n_fields;
+
+        m_nodes.assign(m_n_fields, {});
+        m_cells.assign(m_n_fields, {});
+        m_cell_map.assign(m_n_fields, {});
+        m_cell_valid.assign(m_n_fields, {});
+        m_node_order = std::move(node_order);
+        m_baked_cells.clear();
+        m_baked_cells.resize(m_n_fields);
+        m_mapped_fields = std::move(fields);
+        m_mapping = std::move(mapping);
+        return true;
+    }
+
+    CubicLagrangeDiscreteGrid::FieldData
+    CubicLagrangeDiscreteGrid::fieldData(unsigned int field_id) const
+    {
+        auto fd = m_mapped_fields[field_id];
+        if (!fd.nodes)
+        {
+            fd.nodes = m_nodes[field_id].data();
+            fd.cell_valid = m_cell_valid[field_id].data();
+            fd.n_nodes = m_nodes[field_id].size();
+            fd.n_cells = m_n_cells;
+            fd.node_order = m_node_order[field_id];
+            if (!m_cell_map[field_id].empty())
+            {
+                fd.cells = m_cells[field_id].data();
+                fd.cell_map = m_cell_map[field_id].data();
+                fd.n_cells = m_cells[field_id].size();
+            }
+        }
+        if (!m_baked_cells[field_id].empty())
+            fd.baked = m_baked_cells[field_id].data();
+        return fd;
+    }
+
+    void CubicLagrangeDiscreteGrid::detach(unsigned int field_id)
+    {
+        auto const &fd = m_mapped_fields[field_id];
+        if (!fd.nodes)
+            return;
+
+        m_nodes[field_id].assign(fd.nodes, fd.nodes + fd.n_nodes);
+        m_cells[field_id].clear();
+        m_cell_map[field_id].clear();
+        if (fd.cell_map)
+        {
+            m_cells[field_id].assign(fd.cells, fd.cells + fd.n_cells);
+            m_cell_map[field_id].assign(fd.cell_map, fd.cell_map + m_n_cells);
+        }
+        m_cell_valid[field_id].assign(fd.cell_valid, fd.cell_valid + nValidityWords(fd.n_cells));
+        m_mapped_fields[field_id] = FieldData{};
+
+        if (std::none_of(m_mapped_fields.begin(), m_mapped_fields.end(), [](FieldData const &f)
+                         { return f.nodes != nullptr; }))
+            m_mapping.reset();
+    }
+
+    unsigned int
+    CubicLagrangeDiscreteGrid::addFunction(ContinuousFunction const &func, bool verbose,
+                                           SamplePredicate const &pred, NodeOrder order)
+    {
+        return addFunction(BatchFunction([&func](std::size_t n, float const *xs, float const *ys, float const *zs, float *values)
+                                         {
+                                             for (auto i = std::size_t{0u}; i < n; ++i)
+                                                 values[i] = func(Vector3f(xs[i], ys[i], zs[i]));
+                                         }),
+                           verbose, pred, order);
     }
 
     unsigned int
     CubicLagrangeDiscreteGrid::addFunction(ContinuousFunction const &func, bool verbose,
                                            SamplePredicate const &pred)
     {
-        using namespace std::chrono;
+        return addFunction(func, verbose, pred, NodeOrder::Lexicographic);
+    }
 
-        auto t0_construction = high_resolution_clock::now();
+    unsigned int
+    CubicLagrangeDiscreteGrid::addFunction(BatchFunction const &func, bool verbose,
+                                           SamplePredicate const &pred)
+    {
+        return addFunction(func, verbose, pred, NodeOrder::Lexicographic);
+    }
 
-        auto n = Matrix<unsigned int, 3, 1>::Map(m_resolution.data());
+    unsigned int
+    CubicLagrangeDiscreteGrid::addFunction(BatchFunction const &func, bool verbose,
+                                           SamplePredicate const &pred, NodeOrder order)
+    {
+        using namespace std::chrono;
 
-        auto nv = (n[0] + 1) * (n[1] + 1) * (n[2] + 1);
-        auto ne_x = (n[0] + 0) * (n[1] + 1) * (n[2] + 1);
-        auto ne_y = (n[0] + 1) * (n[1] + 0) * (n[2] + 1);
-        auto ne_z = (n[0] + 1) * (n[1] + 1) * (n[2] + 0);
-        auto ne = ne_x + ne_y + ne_z;
+        auto t0_construction = high_resolution_clock::now();
 
-        auto n_nodes = nv + 2 * ne;
+        auto n_nodes = static_cast<unsigned int>(nNodes(order));
 
+        // Nodes that are not sampled, including the padding of the bricked order, remain undefined.
         m_nodes.push_back({});
         auto &coeffs = m_nodes.back();
-        coeffs.resize(n_nodes);
+        coeffs.assign(n_nodes, std::numeric_limits<float>::max());
+
+        // The nodes are sampled vertex by vertex in tiles of tile_size^3 vertices, which are handed out
+        // dynamically along a z-curve. Each thread thus evaluates neighboring nodes one after the
+        // other, which benefits functions with a warm start such as MeshDistance, and the varying
+        // cost of the nodes is balanced among the threads.
+        auto const tile_size = 8u;
+        auto n_tiles = std::array<unsigned int, 3>{};
+        for (auto d = 0u; d < 3u; ++d)
+            n_tiles[d] = m_resolution[d] / tile_size + 1u;
+        auto tiles = std::vector<unsigned int>(n_tiles[0] * n_tiles[1] * n_tiles[2]);
+        auto keys = std::vector<std::uint64_t>(tiles.size());
+        auto encode = mortonEncoder();
+        for (auto t = 0u; t < tiles.size(); ++t)
+        {
+            tiles[t] = t;
+            keys[t] = encode({{t % n_tiles[0], t / n_tiles[0] % n_tiles[1], t / (n_tiles[0] * n_tiles[1])}});
+        }
+        radixSort(keys, tiles);
 
-        std::atomic_uint counter(0u);
-        SpinLock mutex;
-        auto t0 = high_resolution_clock::now();
+        ProgressReporter progress(nNodes(NodeOrder::Lexicographic), verbose, m_progress_callback);
 
 #pragma omp parallel default(shared)
         {
-#pragma omp for schedule(static) nowait
-            for (int l = 0; l < static_cast<int>(n_nodes); ++l)
-            {
-                auto x = indexToNodePosition(l);
-                auto &c = coeffs[l];
+            // Positions and node indices of the nodes of a tile that are passed to func at once.
+            auto xs = std::vector<float>{}, ys = std::vector<float>{}, zs = std::vector<float>{};
+            auto values = std::vector<float>{};
+            auto indices = std::vector<unsigned int>{};
 
-                if (!pred || pred(x))
-                    c = func(x);
-                else
-                    c = std::numeric_limits<float>::max();
-
-                if (verbose && (++counter == n_nodes || duration_cast<milliseconds>(high_resolution_clock::now() - t0).count() > 1000u))
-                {
-                    std::async(std::launch::async, [&]()
-                               {
-                                   mutex.lock();
-                                   t0 = high_resolution_clock::now();
-                                   std::cout << "\r"
-                                             << "Construction " << std::setw(20)
-                                             << 100.0 * static_cast<float>(counter) / static_cast<float>(n_nodes) << "%";
-                                   mutex.unlock();
-                               });
-                }
+#pragma omp for schedule(dynamic, 1) nowait
+            for (int t = 0; t < static_cast<int>(tiles.size()); ++t)
+            {
+                xs.clear();
+                ys.clear();
+                zs.clear();
+                indices.clear();
+
+                auto tile = tiles[t];
+                auto lo = Matrix<unsigned int, 3, 1>{
+                    tile_size * (tile % n_tiles[0]),
+                    tile_size * (tile / n_tiles[0] % n_tiles[1]),
+                    tile_size * (tile / (n_tiles[0] * n_tiles[1]))};
+                auto hi = Matrix<unsigned int, 3, 1>{
+                    std::min(lo[0] + tile_size, m_resolution[0] + 1u),
+                    std::min(lo[1] + tile_size, m_resolution[1] + 1u),
+                    std::min(lo[2] + tile_size, m_resolution[2] + 1u)};
+
+                auto n_sampled = 0u;
+                for (auto k = lo[2]; k < hi[2]; ++k)
+                    for (auto j = lo[1]; j < hi[1]; ++j)
+                        for (auto i = lo[0]; i < hi[0]; ++i)
+                        {
+                            auto nodes = vertexNodes(i, j, k, order);
+                            auto xv = (m_domain.min() + m_cell_size.cwiseProduct(Vector3f(
+                                                            static_cast<float>(i), static_cast<float>(j), static_cast<float>(k))))
+                                          .eval();
+                            for (auto s = 0u; s < 7u; ++s)
+                            {
+                                if (nodes[s] == std::numeric_limits<unsigned int>::max())
+                                    continue;
+
+                                auto x = xv;
+                                if (s > 0u)
+                                {
+                                    auto d = (s - 1u) / 2u;
+                                    x(d) += (1.0 + static_cast<float>((s - 1u) % 2u)) / 3.0 * m_cell_size[d];
+                                }
+                                if (!pred || pred(x))
+                                {
+                                    xs.push_back(x[0]);
+                                    ys.push_back(x[1]);
+                                    zs.push_back(x[2]);
+                                    indices.push_back(nodes[s]);
+                                }
+                                ++n_sampled;
+                            }
+                        }
+
+                values.resize(indices.size());
+                if (!indices.empty())
+                    func(indices.size(), xs.data(), ys.data(), zs.data(), values.data());
+                for (auto i = 0u; i < indices.size(); ++i)
+                    coeffs[indices[i]] = values[i];
+
+                progress.add(n_sampled);
             }
         }
+        progress.finish();
 
+        // The connectivity of the unreduced field is implicit, see cellNodes.
         m_cells.push_back({});
-        auto &cells = m_cells.back();
-        cells.resize(m_n_cells);
-        for (auto l = 0u; l < m_n_cells; ++l)
-        {
-            auto k = l / (n[1] * n[0]);
-            auto temp = l % (n[1] * n[0]);
-            auto j = temp / n[0];
-            auto i = temp % n[0];
-
-            auto nx = n[0];
-            auto ny = n[1];
-            auto nz = n[2];
-
-            auto &cell = cells[l];
-            cell[0] = (nx + 1) * (ny + 1) * k + (nx + 1) * j + i;
-            cell[1] = (nx + 1) * (ny + 1) * k + (nx + 1) * j + i + 1;
-            cell[2] = (nx + 1) * (ny + 1) * k + (nx + 1) * (j + 1) + i;
-            cell[3] = (nx + 1) * (ny + 1) * k + (nx + 1) * (j + 1) + i + 1;
-            cell[4] = (nx + 1) * (ny + 1) * (k + 1) + (nx + 1) * j + i;
-            cell[5] = (nx + 1) * (ny + 1) * (k + 1) + (nx + 1) * j + i + 1;
-            cell[6] = (nx + 1) * (ny + 1) * (k + 1) + (nx + 1) * (j + 1) + i;
-            cell[7] = (nx + 1) * (ny + 1) * (k + 1) + (nx + 1) * (j + 1) + i + 1;
-
-            auto offset = nv;
-            cell[8] = offset + 2 * (nx * (ny + 1) * k + nx * j + i);
-            cell[9] = cell[8] + 1;
-            cell[10] = offset + 2 * (nx * (ny + 1) * (k + 1) + nx * j + i);
-            cell[11] = cell[10] + 1;
-            cell[12] = offset + 2 * (nx * (ny + 1) * k + nx * (j + 1) + i);
-            cell[13] = cell[12] + 1;
-            cell[14] = offset + 2 * (nx * (ny + 1) * (k + 1) + nx * (j + 1) + i);
-            cell[15] = cell[14] + 1;
-
-            offset += 2 * ne_x;
-            cell[16] = offset + 2 * (ny * (nz + 1) * i + ny * k + j);
-            cell[17] = cell[16] + 1;
-            cell[18] = offset + 2 * (ny * (nz + 1) * (i + 1) + ny * k + j);
-            cell[19] = cell[18] + 1;
-            cell[20] = offset + 2 * (ny * (nz + 1) * i + ny * (k + 1) + j);
-            cell[21] = cell[20] + 1;
-            cell[22] = offset + 2 * (ny * (nz + 1) * (i + 1) + ny * (k + 1) + j);
-            cell[23] = cell[22] + 1;
-
-            offset += 2 * ne_y;
-            cell[24] = offset + 2 * (nz * (nx + 1) * j + nz * i + k);
-            cell[25] = cell[24] + 1;
-            cell[26] = offset + 2 * (nz * (nx + 1) * (j + 1) + nz * i + k);
-            cell[27] = cell[26] + 1;
-            cell[28] = offset + 2 * (nz * (nx + 1) * j + nz * (i + 1) + k);
-            cell[29] = cell[28] + 1;
-            cell[30] = offset + 2 * (nz * (nx + 1) * (j + 1) + nz * (i + 1) + k);
-            cell[31] = cell[30] + 1;
-        }
-
         m_cell_map.push_back({});
-        auto &cell_map = m_cell_map.back();
-        cell_map.resize(m_n_cells);
-        std::iota(cell_map.begin(), cell_map.end(), 0u);
+
+        m_baked_cells.push_back({});
+        m_mapped_fields.push_back({});
+
+        m_cell_valid.push_back({});
+        m_node_order.push_back(order);
+        updateCellValidity(static_cast<unsigned int>(m_n_fields));
 
         if (verbose)
         {
@@ -899,10 +1558,298 @@ namespace Discregrid
         return static_cast<unsigned int>(m_n_fields++);
     }
 
+    unsigned int
+    CubicLagrangeDiscreteGrid::addDistanceFunction(ContinuousFunction const &func, SamplePredicate const &band,
+                                                   bool verbose, NodeOrder order)
+    {
+        using namespace std::chrono;
+
+        auto field_id = addFunction(func, verbose, band, order);
+
+        auto t0 = high_resolution_clock::now();
+        extendDistanceField(field_id);
+        if (verbose)
+        {
+            std::cout << "Extension took " << std::setw(15) << static_cast<float>(duration_cast<milliseconds>(high_resolution_clock::now() - t0).count()) / 1000.0 << "s" << std::endl;
+        }
+
+        return field_id;
+    }
+
+    unsigned int
+    CubicLagrangeDiscreteGrid::addFunctionHierarchical(ContinuousFunction const &func, float band, float lipschitz,
+                                                       bool verbose, NodeOrder order)
+    {
+        // A level holds a discretization of func and bounds of func at its vertices whose magnitude is
+        // a lower bound of |func| and whose sign is exact.
+        struct Level
+        {
+            std::unique_ptr<CubicLagrangeDiscreteGrid> grid;
+            std::vector<float> bound;
+        };
+
+        auto resolutions = std::vector<std::array<unsigned int, 3>>{m_resolution};
+        while (*std::min_element(resolutions.back().begin(), resolutions.back().end()) >= 64u)
+        {
+            auto r = resolutions.back();
+            for (auto &n : r)
+                n = (n + 1u) / 2u;
+            resolutions.push_back(r);
+        }
+
+        std::atomic<std::size_t> n_evaluated(0u);
+        auto level_function = [&](Level const *coarse, DiscreteGrid const &grid, std::vector<float> &bound)
+        {
+            // Nodes of cells intersecting the band are evaluated.
+            auto n = grid.resolution();
+            auto threshold = band + grid.cellSize().norm();
+            bound.assign(std::size_t{n[0] + 1u} * (n[1] + 1u) * (n[2] + 1u), std::numeric_limits<float>::max());
+
+            return ContinuousFunction([&, coarse, n, threshold](Vector3f const &x)
+                                      {
+                auto value = 0.0f;
+                auto b = 0.0f;
+                if (coarse)
+                {
+                    auto const &cg = *coarse->grid;
+                    auto cn = cg.resolution();
+                    auto mi = (x - cg.domain().min()).cwiseProduct(cg.invCellSize()).cast<unsigned int>().eval();
+                    for (auto d = 0u; d < 3u; ++d)
+                        mi[d] = std::min(mi[d], cn[d] - 1u);
+
+                    auto sign = 1.0f;
+                    for (auto c = 0u; c < 8u; ++c)
+                    {
+                        auto v = (mi + Matrix<unsigned int, 3, 1>{c & 1u, c >> 1 & 1u, c >> 2 & 1u}).eval();
+                        auto vb = coarse->bound[(std::size_t{v[2]} * (cn[1] + 1u) + v[1]) * (cn[0] + 1u) + v[0]];
+                        auto xv = (cg.domain().min() + cg.cellSize().cwiseProduct(v.cast<float>())).eval();
+                        auto candidate = std::abs(vb) - lipschitz * (x - xv).norm();
+                        if (candidate > b)
+                        {
+                            b = candidate;
+                            sign = vb < 0.0f ? -1.0f : 1.0f;
+                        }
+                    }
+
+                    if (b > threshold)
+                    {
+                        value = cg.interpolate(0u, x);
+                        if (value == std::numeric_limits<float>::max() || value * sign < b)
+                            value = sign * b;
+                    }
+                    else
+                        b = 0.0f;
+                }
+
+                if (b == 0.0f)
+                {
+                    value = func(x);
+                    b = value;
+                    ++n_evaluated;
+                }
+                else
+                    b = std::copysign(b, value);
+
+                auto s = (x - grid.domain().min()).cwiseProduct(grid.invCellSize()).eval();
+                auto r = s.array().round().eval();
+                if ((s.array() - r).abs().maxCoeff() < 1.0e-3f)
+                    bound[(static_cast<std::size_t>(r[2]) * (n[1] + 1u) + static_cast<std::size_t>(r[1])) * (n[0] + 1u) + static_cast<std::size_t>(r[0])] = b;
+                return value; });
+        };
+
+        // Coarse levels from the coarsest to the second finest one.
+        auto coarse = std::unique_ptr<Level>{};
+        for (auto l = resolutions.size() - 1u; l > 0u; --l)
+        {
+            auto level = std::unique_ptr<Level>(new Level{});
+            level->grid.reset(new CubicLagrangeDiscreteGrid(m_domain, resolutions[l]));
+            level->grid->addFunction(level_function(coarse.get(), *level->grid, level->bound));
+            coarse = std::move(level);
+        }
+
+        auto bound = std::vector<float>{};
+        auto field_id = addFunction(level_function(coarse.get(), *this, bound), verbose, nullptr, order);
+        if (verbose)
+        {
+            std::cout << "Evaluated the function at " << n_evaluated << " nodes on " << resolutions.size() << " levels" << std::endl;
+        }
+        return field_id;
+    }
+
     bool
-    CubicLagrangeDiscreteGrid::determineShapeFunctions(unsigned int field_id, Eigen::Vector3f const &x,
-                                                       std::array<unsigned int, 32> &cell, Eigen::Vector3f &c0, Eigen::Matrix<float, 32, 1> &N,
-                                                       Eigen::Matrix<float, 32, 3> *dN) const
+    CubicLagrangeDiscreteGrid::extendDistanceField(unsigned int field_id)
+    {
+        if (fieldData(field_id).cell_map)
+            return false;
+        detach(field_id);
+
+        auto &coeffs = m_nodes[field_id];
+        auto order = m_node_order[field_id];
+        auto const undefined = std::numeric_limits<float>::max();
+
+        auto n = Matrix<int, 3, 1>{static_cast<int>(m_resolution[0]) + 1, static_cast<int>(m_resolution[1]) + 1,
+                                   static_cast<int>(m_resolution[2]) + 1};
+        auto vertex = [&](int i, int j, int k)
+        {
+            return (static_cast<std::size_t>(k) * n[1] + j) * n[0] + i;
+        };
+
+        // Lattice coordinates of a node; vertices have integer coordinates, edge nodes a single
+        // fractional coordinate of 1/3 or 2/3.
+        auto lattice = [&](unsigned int l, Vector3f &s)
+        {
+            auto x = Vector3f{};
+            if (!nodePosition(l, order, x))
+                return false;
+            s = (x - m_domain.min()).cwiseProduct(m_inv_cell_size);
+            return true;
+        };
+
+        // The defined vertex coefficients seed the extension and remain fixed. The undefined ones are
+        // initialized to std::numeric_limits<float>::max(), which acts as infinity.
+        auto u = std::vector<float>(vertex(0, 0, n[2]), undefined);
+        auto seed = std::vector<unsigned char>(u.size(), 0u);
+        auto n_seeds = 0;
+#pragma omp parallel for schedule(static) reduction(+ : n_seeds)
+        for (int l = 0; l < static_cast<int>(coeffs.size()); ++l)
+        {
+            auto s = Vector3f{};
+            if (coeffs[l] == undefined || !lattice(l, s))
+                continue;
+            auto r = s.array().round().eval();
+            if ((s.array() - r).abs().maxCoeff() > 0.25f)
+                continue;
+            auto v = vertex(static_cast<int>(r[0]), static_cast<int>(r[1]), static_cast<int>(r[2]));
+            u[v] = coeffs[l];
+            seed[v] = 1u;
+            ++n_seeds;
+        }
+        if (n_seeds == 0)
+            return false;
+
+        auto h = m_cell_size;
+        auto tolerance = 1.0e-5f * h.minCoeff();
+
+        // Godunov upwind update of vertex (i, j, k) from the smallest neighbor in each direction,
+        // i.e. the solution of sum_d ((u - a_d) / h_d)^2 = 1 over the neighbors a_d < u.
+        auto update = [&](int i, int j, int k)
+        {
+            auto v = vertex(i, j, k);
+            if (seed[v])
+                return false;
+
+            int const ijk[3] = {i, j, k};
+            std::pair<float, float> a[3];
+            auto sign = 1.0f;
+            auto a_min = undefined;
+            for (auto d = 0; d < 3; ++d)
+            {
+                a[d] = {undefined, h[d]};
+                for (auto o : {-1, 1})
+                {
+                    auto m = ijk[d] + o;
+                    if (m < 0 || m >= n[d])
+                        continue;
+                    auto w = u[v + o * (d == 0 ? 1 : d == 1 ? n[0] : static_cast<std::ptrdiff_t>(n[0]) * n[1])];
+                    if (std::abs(w) < a[d].first)
+                        a[d].first = std::abs(w);
+                    if (std::abs(w) < a_min)
+                    {
+                        a_min = std::abs(w);
+                        sign = w < 0.0f ? -1.0f : 1.0f;
+                    }
+                }
+            }
+            if (a_min == undefined)
+                return false;
+            std::sort(a, a + 3);
+
+            auto val = a[0].first + a[0].second;
+            auto A = 0.0f, B = 0.0f, C = -1.0f;
+            for (auto d = 0; d < 3 && val > a[d].first; ++d)
+            {
+                auto w = 1.0f / (a[d].second * a[d].second);
+                A += w;
+                B += w * a[d].first;
+                C += w * a[d].first * a[d].first;
+                if (d > 0)
+                    val = (B + std::sqrt(std::max(B * B - A * C, 0.0f))) / A;
+            }
+
+            if (val >= std::abs(u[v]) - tolerance)
+                return false;
+            u[v] = sign * val;
+            return true;
+        };
+
+        // Gauss-Seidel sweeps in the eight diagonal directions until no vertex changes. Within a
+        // sweep, the vertices on a plane i + j + k = p only depend on the planes p - 1 and p + 1
+        // and are therefore updated in parallel.
+        for (auto iteration = 0u; iteration < 16u; ++iteration)
+        {
+            auto changed = false;
+            for (auto dir = 0u; dir < 8u; ++dir)
+            {
+                for (auto p = 0; p <= n[0] + n[1] + n[2] - 3; ++p)
+                {
+#pragma omp parallel for schedule(static) reduction(|| : changed)
+                    for (int kk = std::max(0, p - (n[0] - 1) - (n[1] - 1)); kk <= std::min(n[2] - 1, p); ++kk)
+                    {
+                        auto jj0 = std::max(0, p - kk - (n[0] - 1));
+                        auto jj1 = std::min(n[1] - 1, p - kk);
+                        for (auto jj = jj0; jj <= jj1; ++jj)
+                        {
+                            auto ii = p - kk - jj;
+                            auto i = dir & 1u ? n[0] - 1 - ii : ii;
+                            auto j = dir & 2u ? n[1] - 1 - jj : jj;
+                            auto k = dir & 4u ? n[2] - 1 - kk : kk;
+                            changed = update(i, j, k) || changed;
+                        }
+                    }
+                }
+            }
+            if (!changed)
+                break;
+        }
+
+        // Undefined vertex coefficients take the vertex solution, undefined edge coefficients are
+        // interpolated along their edge.
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < static_cast<int>(coeffs.size()); ++l)
+        {
+            auto s = Vector3f{};
+            if (coeffs[l] != undefined || !lattice(l, s))
+                continue;
+
+            auto r = s.array().round().cast<int>().eval();
+            auto d = 0;
+            auto frac = (s.array() - r.cast<float>()).abs().maxCoeff(&d);
+            if (frac <= 0.25f)
+            {
+                coeffs[l] = u[vertex(r[0], r[1], r[2])];
+                continue;
+            }
+
+            auto r1 = r;
+            r[d] = static_cast<int>(std::floor(s[d]));
+            r1[d] = r[d] + 1;
+            auto u0 = u[vertex(r[0], r[1], r[2])];
+            auto u1 = u[vertex(r1[0], r1[1], r1[2])];
+            if (u0 == undefined || u1 == undefined)
+                continue;
+            auto t = s[d] - static_cast<float>(r[d]);
+            coeffs[l] = (1.0f - t) * u0 + t * u1;
+        }
+
+        updateCellValidity(field_id);
+        if (isBaked(field_id))
+            bake(field_id);
+        return true;
+    }
+
+    bool
+    CubicLagrangeDiscreteGrid::locateCell(unsigned int const *cell_map, Vector3f const &x,
+                                          unsigned int &cell_index, Vector3f &xi, Vector3f &c0) const
     {
         if (!m_domain.contains(x))
             return false;
@@ -915,20 +1862,30 @@ namespace Discregrid
         if (mi[2] >= m_resolution[2])
             mi[2] = m_resolution[2] - 1;
         auto i = multiToSingleIndex({{mi(0), mi(1), mi(2)}});
-        auto i_ = m_cell_map[field_id][i];
-        if (i_ == std::numeric_limits<unsigned int>::max())
+        cell_index = cell_map ? cell_map[i] : i;
+        if (cell_index == std::numeric_limits<unsigned int>::max())
             return false;
 
         auto sd = subdomain(i);
-        i = i_;
-        auto d = sd.diagonal().eval();
-
         auto denom = (sd.max() - sd.min()).eval();
         c0 = Vector3f::Constant(2.0).cwiseQuotient(denom).eval();
         auto c1 = (sd.max() + sd.min()).cwiseQuotient(denom).eval();
-        auto xi = (c0.cwiseProduct(x) - c1).eval();
+        xi = (c0.cwiseProduct(x) - c1).eval();
+        return true;
+    }
+
+    bool
+    CubicLagrangeDiscreteGrid::determineShapeFunctions(unsigned int field_id, Eigen::Vector3f const &x,
+                                                       std::array<unsigned int, 32> &cell, Eigen::Vector3f &c0, Eigen::Matrix<float, 32, 1> &N,
+                                                       Eigen::Matrix<float, 32, 3> *dN) const
+    {
+        auto fd = fieldData(field_id);
+        auto i = 0u;
+        auto xi = Vector3f{};
+        if (!locateCell(fd.cell_map, x, i, xi, c0))
+            return false;
 
-        cell = m_cells[field_id][i];
+        cell = fd.cells ? fd.cells[i] : cellNodes(i, fd.node_order);
         N = shape_function_(xi, dN);
         return true;
     }
@@ -937,243 +1894,327 @@ namespace Discregrid
     CubicLagrangeDiscreteGrid::interpolate(unsigned int field_id, Eigen::Vector3f const &xi, const std::array<unsigned int, 32> &cell, const Eigen::Vector3f &c0, const Eigen::Matrix<float, 32, 1> &N,
                                            Eigen::Vector3f *gradient, Eigen::Matrix<float, 32, 3> *dN) const
     {
-        if (!gradient)
+        float c[32];
+        gather(fieldData(field_id).nodes, cell, c);
+        if (!defined(c))
         {
-            auto phi = 0.0;
-            for (auto j = 0u; j < 32u; ++j)
-            {
-                auto v = cell[j];
-                auto c = m_nodes[field_id][v];
-                if (c == std::numeric_limits<float>::max())
-                {
-                    return std::numeric_limits<float>::max();
-                }
-                phi += c * N[j];
-            }
-
-            return phi;
-        }
-
-        auto phi = 0.0;
-        gradient->setZero();
-        for (auto j = 0u; j < 32u; ++j)
-        {
-            auto v = cell[j];
-            auto c = m_nodes[field_id][v];
-            if (c == std::numeric_limits<float>::max())
-            {
+            if (gradient)
                 gradient->setZero();
-                return std::numeric_limits<float>::max();
-            }
-            phi += c * N[j];
-            (*gradient)(0) += c * (*dN)(j, 0);
-            (*gradient)(1) += c * (*dN)(j, 1);
-            (*gradient)(2) += c * (*dN)(j, 2);
+            return std::numeric_limits<float>::max();
         }
-        gradient->array() *= c0.array();
-
-        return phi;
+        return contract(c, N, dN, c0, gradient);
     }
 
     float
     CubicLagrangeDiscreteGrid::interpolate(unsigned int field_id, Vector3f const &x,
                                            Vector3f *gradient) const
     {
-        if (!m_domain.contains(x))
+        auto i = 0u;
+        auto xi = Vector3f{};
+        auto c0 = Vector3f{};
+        auto fd = fieldData(field_id);
+        if (!locateCell(fd.cell_map, x, i, xi, c0))
             return std::numeric_limits<float>::max();
 
-        auto mi = (x - m_domain.min()).cwiseProduct(m_inv_cell_size).cast<unsigned int>().eval();
-        if (mi[0] >= m_resolution[0])
-            mi[0] = m_resolution[0] - 1;
-        if (mi[1] >= m_resolution[1])
-            mi[1] = m_resolution[1] - 1;
-        if (mi[2] >= m_resolution[2])
-            mi[2] = m_resolution[2] - 1;
-        auto i = multiToSingleIndex({{mi(0), mi(1), mi(2)}});
-        auto i_ = m_cell_map[field_id][i];
-        if (i_ == std::numeric_limits<unsigned int>::max())
+        if (!testBit(fd.cell_valid, i))
+        {
+            if (gradient)
+                gradient->setZero();
             return std::numeric_limits<float>::max();
+        }
 
-        auto sd = subdomain(i);
-        i = i_;
-        auto d = sd.diagonal().eval();
-
-        auto denom = (sd.max() - sd.min()).eval();
-        auto c0 = Vector3f::Constant(2.0).cwiseQuotient(denom).eval();
-        auto c1 = (sd.max() + sd.min()).cwiseQuotient(denom).eval();
-        auto xi = (c0.cwiseProduct(x) - c1).eval();
+        float gathered[32];
+        auto c = static_cast<float const *>(gathered);
+        if (fd.baked)
+            c = fd.baked + 32u * i;
+        else
+            gatherCell(fd, i, gathered);
 
-        auto const &cell = m_cells[field_id][i];
         if (!gradient)
         {
-            //auto phi = m_coefficients[field_id][i].dot(shape_function_(xi, nullptr));
-            auto phi = 0.0;
             auto N = shape_function_(xi, nullptr);
-            for (auto j = 0u; j < 32u; ++j)
+            return contract(c, N, nullptr, c0, nullptr);
+        }
+
+        auto dN = Matrix<float, 32, 3>{};
+        auto N = shape_function_(xi, &dN);
+        return contract(c, N, &dN, c0, gradient);
+    }
+
+    void
+    CubicLagrangeDiscreteGrid::interpolateBatch(unsigned int field_id, std::size_t n,
+                                                float const *xs, float const *ys, float const *zs, float *values,
+                                                float *gx, float *gy, float *gz) const
+    {
+        // Resolve the per-field containers once for the whole batch instead of once per query.
+        auto fd = fieldData(field_id);
+        auto with_gradient = gx && gy && gz;
+
+        // The queries are processed in blocks matching the lane count of the shape function kernel.
+        auto const &kernel = simd::shapeFunctionKernel();
+        auto w = kernel.width;
+        auto n_blocks = static_cast<int>((n + w - 1) / w);
+
+#pragma omp parallel for schedule(static)
+        for (int b = 0; b < n_blocks; ++b)
+        {
+            unsigned int const W = simd::max_kernel_width;
+            float xi[W], yi[W], zi[W], c0[3][W];
+            float N[32 * W], dN[3 * 32 * W], C[32 * W];
+            float phi[W], grad[3][W];
+            bool defined[W];
+
+            auto begin = static_cast<std::size_t>(b) * w;
+            auto m = static_cast<unsigned int>(std::min<std::size_t>(w, n - begin));
+
+            // Locate the cells and gather their coefficients lane-major. Unused and undefined lanes
+            // are evaluated at the cell center with zero coefficients.
+            for (auto lane = 0u; lane < w; ++lane)
             {
-                auto v = cell[j];
-                auto c = m_nodes[field_id][v];
-                if (c == std::numeric_limits<float>::max())
+                auto i = 0u;
+                auto xi_ = Vector3f::Zero().eval();
+                auto c0_ = Vector3f::Zero().eval();
+                defined[lane] = lane < m &&
+                                locateCell(fd.cell_map, Vector3f{xs[begin + lane], ys[begin + lane], zs[begin + lane]}, i, xi_, c0_) &&
+                                testBit(fd.cell_valid, i);
+                if (!defined[lane])
+                {
+                    xi_.setZero();
+                    for (auto j = 0u; j < 32u; ++j)
+                        C[j * w + lane] = 0.0f;
+                }
+                else if (fd.baked)
+                {
+                    for (auto j = 0u; j < 32u; ++j)
+                        C[j * w + lane] = fd.baked[32u * i + j];
+                }
+                else
                 {
-                    return std::numeric_limits<float>::max();
+                    auto const cell = fd.cells ? fd.cells[i] : cellNodes(i, fd.node_order);
+                    for (auto j = 0u; j < 32u; ++j)
+                        C[j * w + lane] = fd.nodes[cell[j]];
                 }
-                phi += c * N[j];
+
+                xi[lane] = xi_[0];
+                yi[lane] = xi_[1];
+                zi[lane] = xi_[2];
+                for (auto d = 0u; d < 3u; ++d)
+                    c0[d][lane] = c0_[d];
             }
 
-            return phi;
-        }
+            kernel.evaluate(xi, yi, zi, N, with_gradient ? dN : nullptr);
 
-        auto dN = Matrix<float, 32, 3>{};
-        auto N = shape_function_(xi, &dN);
+            for (auto lane = 0u; lane < w; ++lane)
+                phi[lane] = 0.0f;
+            for (auto j = 0u; j < 32u; ++j)
+                for (auto lane = 0u; lane < w; ++lane)
+                    phi[lane] += C[j * w + lane] * N[j * w + lane];
 
-        // TEST
-        //auto eps = 1.0e-6;
-        //auto ndN = Matrix<float, 32, 3>{};
-        //for (auto j = 0u; j < 3u; ++j)
-        //{
-        //    auto xip = xi;
-        //    xip(j) += eps;
-        //    auto xim = xi;
-        //    xim(j) -= eps;
-        //    auto Np = shape_function_(xip, nullptr);
-        //    auto Nm = shape_function_(xim, nullptr);
-        //    ndN.col(j) = (Np - Nm) / (2.0 * eps);
-        //}
-        //std::cout << (dN - ndN).cwiseAbs().maxCoeff() /*/ (dN.maxCoeff())*/ << std::endl;
-        ///
-
-        auto phi = 0.0;
-        gradient->setZero();
-        for (auto j = 0u; j < 32u; ++j)
-        {
-            auto v = cell[j];
-            auto c = m_nodes[field_id][v];
-            if (c == std::numeric_limits<float>::max())
+            if (with_gradient)
             {
-                gradient->setZero();
-                return std::numeric_limits<float>::max();
+                for (auto d = 0u; d < 3u; ++d)
+                {
+                    for (auto lane = 0u; lane < w; ++lane)
+                        grad[d][lane] = 0.0f;
+                    for (auto j = 0u; j < 32u; ++j)
+                        for (auto lane = 0u; lane < w; ++lane)
+                            grad[d][lane] += C[j * w + lane] * dN[(d * 32u + j) * w + lane];
+                    for (auto lane = 0u; lane < w; ++lane)
+                        grad[d][lane] *= c0[d][lane];
+                }
             }
-            phi += c * N[j];
-            (*gradient)(0) += c * dN(j, 0);
-            (*gradient)(1) += c * dN(j, 1);
-            (*gradient)(2) += c * dN(j, 2);
-        }
-        gradient->array() *= c0.array();
 
-        return phi;
+            for (auto lane = 0u; lane < m; ++lane)
+            {
+                values[begin + lane] = defined[lane] ? phi[lane] : std::numeric_limits<float>::max();
+                if (with_gradient)
+                {
+                    gx[begin + lane] = grad[0][lane];
+                    gy[begin + lane] = grad[1][lane];
+                    gz[begin + lane] = grad[2][lane];
+                }
+            }
+        }
     }
 
     void CubicLagrangeDiscreteGrid::reduceField(unsigned int field_id, Predicate pred)
     {
+        detach(field_id);
+        makeConnectivityExplicit(field_id);
+
         auto &coeffs = m_nodes[field_id];
         auto &cells = m_cells[field_id];
-        auto keep = std::vector<bool>(coeffs.size());
-        for (auto l = 0u; l < coeffs.size(); ++l)
-        {
-            auto xi = indexToNodePosition(l);
-            keep[l] = pred(xi, coeffs[l]) && coeffs[l] != std::numeric_limits<float>::max();
-        }
-
         auto &cell_map = m_cell_map[field_id];
-        cell_map.resize(m_n_cells);
-        std::iota(cell_map.begin(), cell_map.end(), 0u);
-
-        auto cells_ = cells;
-        cells.clear();
-        for (auto i = 0u; i < cells_.size(); ++i)
+        auto n_nodes = static_cast<int>(coeffs.size());
+        auto n_cells = static_cast<int>(cells.size());
+
+        // The nodes of a field reduced before are not in a node order, such that the position of a
+        // node is derived from a cell containing it. Every such cell yields the same lexicographic
+        // index. Nodes without a cell, e.g. the padding of the bricked order, are left out.
+        auto lexicographic_index = std::vector<unsigned int>(coeffs.size(), std::numeric_limits<unsigned int>::max());
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < static_cast<int>(m_n_cells); ++l)
         {
-            auto keep_cell = false;
-            auto vals = std::vector<float>{};
-            for (auto v : cells_[i])
-            {
-                keep_cell |= keep[v];
-                vals.push_back(coeffs[v]);
-            }
-            if (keep_cell)
+            auto c = cell_map[l];
+            if (c == std::numeric_limits<unsigned int>::max())
+                continue;
+            auto lexicographic_nodes = cellNodes(l, NodeOrder::Lexicographic);
+            for (auto j = 0u; j < 32u; ++j)
             {
-                cells.push_back(cells_[i]);
-                cell_map[i] = static_cast<unsigned int>(cells.size() - 1);
+#pragma omp atomic write
+                lexicographic_index[cells[c][j]] = lexicographic_nodes[j];
             }
-            else
-                cell_map[i] = std::numeric_limits<unsigned int>::max();
         }
+        auto position = [&](unsigned int l, Vector3f &x)
+        {
+            if (lexicographic_index[l] == std::numeric_limits<unsigned int>::max())
+                return false;
+            x = indexToNodePosition(lexicographic_index[l]);
+            return true;
+        };
 
-        auto n = Matrix<unsigned int, 3, 1>::Map(m_resolution.data());
-
-        auto nv = (n[0] + 1) * (n[1] + 1) * (n[2] + 1);
-        auto ne_x = (n[0] + 0) * (n[1] + 1) * (n[2] + 1);
-        auto ne_y = (n[0] + 1) * (n[1] + 0) * (n[2] + 1);
-        auto ne_z = (n[0] + 1) * (n[1] + 1) * (n[2] + 0);
-        auto ne = ne_x + ne_y + ne_z;
-
-        // Reduce vertices.
-        auto xi = Vector3f{};
-        auto z_values = std::vector<uint64_t>(coeffs.size());
-        for (auto l = 0u; l < coeffs.size(); ++l)
+        // Nodes fulfilling the predicate.
+        auto flag = std::vector<unsigned char>(coeffs.size());
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < n_nodes; ++l)
         {
-            auto xi = indexToNodePosition(l);
-            z_values[l] = zValue(xi, 4.0 * m_inv_cell_size.minCoeff());
+            auto x = Vector3f{};
+            flag[l] = coeffs[l] != std::numeric_limits<float>::max() && position(l, x) && pred(x, coeffs[l]);
         }
 
-        std::fill(keep.begin(), keep.end(), false);
-
-        auto vertex_to_cell = std::vector<std::set<std::pair<unsigned int, unsigned int>>>(coeffs.size());
-        for (auto c = 0u; c < cells.size(); ++c)
+        // Cells with at least one such node are kept and numbered by a prefix sum.
+        auto new_cell_index = std::vector<unsigned int>(cells.size());
+#pragma omp parallel for schedule(static)
+        for (int c = 0; c < n_cells; ++c)
         {
-            auto const &cell = cells[c];
+            auto keep_cell = 0u;
+            for (auto v : cells[c])
+                keep_cell |= flag[v];
+            new_cell_index[c] = keep_cell;
+        }
+        auto keep_cell = new_cell_index;
+        auto n_kept_cells = exclusiveScan(new_cell_index);
 
-            for (auto j = 0u; j < cell.size(); ++j)
+        auto new_cells = std::vector<std::array<unsigned int, 32>>(n_kept_cells);
+        std::fill(flag.begin(), flag.end(), 0u);
+#pragma omp parallel for schedule(static)
+        for (int c = 0; c < n_cells; ++c)
+        {
+            if (!keep_cell[c])
+                continue;
+            new_cells[new_cell_index[c]] = cells[c];
+            for (auto v : cells[c])
             {
-                auto v = cell[j];
-                keep[v] = true;
-                vertex_to_cell[v].insert({c, j});
+#pragma omp atomic write
+                flag[v] = 1u;
             }
         }
-        auto last_vertex = static_cast<unsigned int>(coeffs.size() - 1);
-        for (auto i = static_cast<int>(coeffs.size() - 1); i >= 0; --i)
+
+        // Compose the cell map with the numbering of the kept cells.
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < static_cast<int>(m_n_cells); ++l)
+        {
+            auto c = cell_map[l];
+            if (c != std::numeric_limits<unsigned int>::max())
+                cell_map[l] = keep_cell[c] ? new_cell_index[c] : std::numeric_limits<unsigned int>::max();
+        }
+        keep_cell = {};
+        new_cell_index = {};
+        cells = {};
+
+        // All nodes of the kept cells are kept and ordered along a z-curve. Their positions are known,
+        // as the kept cells are referenced by the cell map.
+        auto node_index = std::vector<unsigned int>(coeffs.size());
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < n_nodes; ++l)
         {
-            if (!keep[i])
+            node_index[l] = flag[l];
+        }
+        auto n_kept_nodes = exclusiveScan(node_index);
+
+        // The keys are generated in ascending node order, the stable radix sort therefore reproduces
+        // the ordering by (key, node index).
+        auto keys = std::vector<uint64_t>(n_kept_nodes);
+        auto order = std::vector<unsigned int>(n_kept_nodes);
+        auto encode = mortonEncoder();
+        auto inv_key_size = 4.0f * m_inv_cell_size.minCoeff();
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < n_nodes; ++l)
+        {
+            if (flag[l])
             {
-                std::swap(coeffs[i], coeffs[last_vertex]);
-                std::swap(z_values[i], z_values[last_vertex]);
-                std::swap(vertex_to_cell[i], vertex_to_cell[last_vertex]);
-                for (auto const &kvp : vertex_to_cell[i])
-                {
-                    cells[kvp.first][kvp.second] = i;
-                }
-                for (auto const &kvp : vertex_to_cell[last_vertex])
-                {
-                    cells[kvp.first][kvp.second] = last_vertex;
-                }
-
-                last_vertex--;
+                auto x = indexToNodePosition(lexicographic_index[l]);
+                keys[node_index[l]] = zValue(encode, x, m_domain.min(), inv_key_size);
+                order[node_index[l]] = static_cast<unsigned int>(l);
             }
         }
-        coeffs.resize(last_vertex + 1);
-        z_values.resize(coeffs.size());
+        flag = {};
+        lexicographic_index = {};
+        radixSort(keys, order);
+        keys = {};
+
+        auto new_coeffs = std::vector<float>(n_kept_nodes);
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < static_cast<int>(n_kept_nodes); ++i)
+        {
+            auto l = order[i];
+            new_coeffs[i] = coeffs[l];
+            node_index[l] = i;
+        }
+        order = {};
+
+#pragma omp parallel for schedule(static)
+        for (int c = 0; c < static_cast<int>(n_kept_cells); ++c)
+        {
+            for (auto &v : new_cells[c])
+                v = node_index[v];
+        }
 
-        auto sort_pattern = std::vector<unsigned int>(coeffs.size());
-        std::iota(sort_pattern.begin(), sort_pattern.end(), 0u);
-        std::sort(sort_pattern.begin(), sort_pattern.end(),
-                  [&](unsigned int i, unsigned int j)
-                  {
-                      return z_values[i] < z_values[j];
-                  });
+        coeffs = std::move(new_coeffs);
+        cells = std::move(new_cells);
+
+        updateCellValidity(field_id);
+        if (isBaked(field_id))
+            bake(field_id);
+    }
 
-        for (auto i = 0u; i < sort_pattern.size(); ++i)
+    void CubicLagrangeDiscreteGrid::updateCellValidity(unsigned int field_id)
+    {
+        auto fd = fieldData(field_id);
+        auto &cell_valid = m_cell_valid[field_id];
+        cell_valid.assign(nValidityWords(fd.n_cells), 0u);
+
+#pragma omp parallel for schedule(static)
+        for (int w = 0; w < static_cast<int>(cell_valid.size()); ++w)
         {
-            auto j = sort_pattern[i];
-            for (auto const &kvp : vertex_to_cell[j])
+            auto bits = std::uint32_t{0u};
+            float c[32];
+            for (auto b = 0u; b < 32u && 32u * w + b < fd.n_cells; ++b)
             {
-                assert(cells[kvp.first][kvp.second] == j);
-                cells[kvp.first][kvp.second] = i;
+                gatherCell(fd, 32u * w + b, c);
+                if (defined(c))
+                    bits |= 1u << b;
             }
+            cell_valid[w] = bits;
+        }
+    }
+
+    void CubicLagrangeDiscreteGrid::bake(unsigned int field_id)
+    {
+        auto fd = fieldData(field_id);
+        auto &baked = m_baked_cells[field_id];
+        baked.resize(32u * fd.n_cells);
+
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < static_cast<int>(fd.n_cells); ++i)
+        {
+            gatherCell(fd, i, &baked[32u * i]);
         }
+    }
 
-        auto coeffs_ = coeffs;
-        std::transform(sort_pattern.begin(), sort_pattern.end(), coeffs.begin(),
-                       [&coeffs_](unsigned int i)
-                       { return coeffs_[i]; });
+    bool CubicLagrangeDiscreteGrid::isBaked(unsigned int field_id) const
+    {
+        return !m_baked_cells[field_id].empty();
     }
 
     void CubicLagrangeDiscreteGrid::forEachCell(unsigned int field_id,
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <cstdint>
+#include <limits>
+
+namespace Discregrid
+{
+
+    // Evaluates the 32 cubic serendipity shape functions at the local cell coordinates xi in
+    // [-1, 1]^3 and, if gradient is given, their derivatives with respect to xi. The node order
+    // matches the cell layout of CubicLagrangeDiscreteGrid.
+    Eigen::Matrix<float, 32, 1>
+    cubicLagrangeShapeFunctions(Eigen::Vector3f const &xi, Eigen::Matrix<float, 32, 3> *gradient = nullptr);
+
+    // Returns bit i of the bit set bits, e.g. the validity of cell i.
+    inline bool
+    testBit(std::uint32_t const *bits, unsigned int i)
+    {
+        return ((bits[i >> 5] >> (i & 31u)) & 1u) != 0u;
+    }
+
+    // Returns true if none of the 32 coefficients c of a cell is undefined. Evaluates all
+    // coefficients without early exit so that the test compiles to a branch-free reduction.
+    inline bool
+    defined(float const *c)
+    {
+        auto undefined = false;
+        for (auto j = 0u; j < 32u; ++j)
+            undefined |= c[j] == std::numeric_limits<float>::max();
+        return !undefined;
+    }
+
+    // Contracts the 32 coefficients c of a fully defined cell with the shape functions N and, if
+    // a gradient is requested, with their derivatives dN scaled by the local to global factors c0.
+    inline float
+    contract(float const *c, Eigen::Matrix<float, 32, 1> const &N, Eigen::Matrix<float, 32, 3> const *dN,
+             Eigen::Vector3f const &c0, Eigen::Vector3f *gradient)
+    {
+        auto phi = 0.0f;
+        for (auto j = 0u; j < 32u; ++j)
+            phi += c[j] * N[j];
+
+        if (gradient)
+        {
+            auto g0 = 0.0f, g1 = 0.0f, g2 = 0.0f;
+            for (auto j = 0u; j < 32u; ++j)
+            {
+                g0 += c[j] * (*dN)(j, 0);
+                g1 += c[j] * (*dN)(j, 1);
+                g2 += c[j] * (*dN)(j, 2);
+            }
+            *gradient = Eigen::Vector3f{g0, g1, g2}.cwiseProduct(c0);
+        }
+
+        return phi;
+    }
+
+}
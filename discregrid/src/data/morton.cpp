@@ -0,0 +1,24 @@
+#include "morton.hpp"
+#include "z_sort_table.hpp"
+#include "../utility/cpu_features.hpp"
+
+namespace Discregrid
+{
+
+    std::uint64_t
+    mortonEncodeTable(std::array<unsigned int, 3> const &x)
+    {
+        return morton_lut(x);
+    }
+
+    MortonEncoder
+    mortonEncoder()
+    {
+#if defined(DISCREGRID_BMI2)
+        if (cpuFeatures().fast_pdep)
+            return mortonEncodeBMI2;
+#endif
+        return mortonEncodeTable;
+    }
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace Discregrid
+{
+
+    // Computes the 64 bit Morton code (z-curve index) of a point given by unsigned integer
+    // coordinates. The bits of x, y and z are interleaved starting with x in the least significant
+    // bit, i.e. the lower 22 bits of x and the lower 21 bits of y and z are encoded.
+    using MortonEncoder = std::uint64_t (*)(std::array<unsigned int, 3> const &);
+
+    // Returns the encoder based on the BMI2 instruction pdep if the executing CPU executes it in
+    // hardware and the table based encoder morton_lut otherwise, e.g. on AMD CPUs before Zen 3.
+    // Both produce identical codes.
+    MortonEncoder mortonEncoder();
+
+    std::uint64_t mortonEncodeTable(std::array<unsigned int, 3> const &x);
+#if defined(DISCREGRID_BMI2)
+    std::uint64_t mortonEncodeBMI2(std::array<unsigned int, 3> const &x);
+#endif
+
+}
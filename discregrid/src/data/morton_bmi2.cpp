@@ -0,0 +1,17 @@
+// Compiled with BMI2 enabled. Do not include headers other than the intrinsics and the declaration.
+#include "morton.hpp"
+
+#include <immintrin.h>
+
+namespace Discregrid
+{
+
+    std::uint64_t
+    mortonEncodeBMI2(std::array<unsigned int, 3> const &x)
+    {
+        return _pdep_u64(x[0], 0x9249249249249249ull) |
+               _pdep_u64(x[1], 0x2492492492492492ull) |
+               _pdep_u64(x[2], 0x4924924924924924ull);
+    }
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Discregrid
+{
+
+    // Sorts keys in ascending order and applies the same permutation to values. The sort is a stable
+    // least significant digit radix sort with 8 bit digits. Each pass computes per-block digit
+    // histograms and scatters the blocks in parallel; passes over digits that are equal for all keys,
+    // e.g. the constant high bits of Morton codes of a bounded domain, are skipped.
+    template <typename V>
+    void radixSort(std::vector<std::uint64_t> &keys, std::vector<V> &values)
+    {
+        auto const block_size = std::size_t{1u} << 16;
+        auto n = keys.size();
+        if (n < 2u)
+            return;
+
+        auto n_blocks = static_cast<int>((n + block_size - 1) / block_size);
+        auto keys_tmp = std::vector<std::uint64_t>(n);
+        auto values_tmp = std::vector<V>(n);
+        auto histograms = std::vector<std::array<std::size_t, 256>>(n_blocks);
+
+        // Bits in which at least two keys differ.
+        auto all_or = std::uint64_t{0u};
+        auto all_and = ~std::uint64_t{0u};
+        for (auto k : keys)
+        {
+            all_or |= k;
+            all_and &= k;
+        }
+        auto varying = all_or ^ all_and;
+
+        for (auto shift = 0u; shift < 64u; shift += 8u)
+        {
+            if (((varying >> shift) & 0xffu) == 0u)
+                continue;
+
+#pragma omp parallel for schedule(static)
+            for (int b = 0; b < n_blocks; ++b)
+            {
+                auto &h = histograms[b];
+                h.fill(0u);
+                auto end = std::min(n, (b + 1) * block_size);
+                for (auto i = b * block_size; i < end; ++i)
+                    ++h[(keys[i] >> shift) & 0xffu];
+            }
+
+            // Turn the histograms into the output offsets of each digit of each block.
+            auto offset = std::size_t{0u};
+            for (auto d = 0u; d < 256u; ++d)
+            {
+                for (auto b = 0; b < n_blocks; ++b)
+                {
+                    auto count = histograms[b][d];
+                    histograms[b][d] = offset;
+                    offset += count;
+                }
+            }
+
+#pragma omp parallel for schedule(static)
+            for (int b = 0; b < n_blocks; ++b)
+            {
+                auto &h = histograms[b];
+                auto end = std::min(n, (b + 1) * block_size);
+                for (auto i = b * block_size; i < end; ++i)
+                {
+                    auto j = h[(keys[i] >> shift) & 0xffu]++;
+                    keys_tmp[j] = keys[i];
+                    values_tmp[j] = values[i];
+                }
+            }
+
+            keys.swap(keys_tmp);
+            values.swap(values_tmp);
+        }
+    }
+
+}
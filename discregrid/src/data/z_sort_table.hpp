@@ -119,7 +119,7 @@ inline uint64_t morton_lut(std::array<unsigned int, 3> const &x)
     answer = morton256_z[(x[2] >> 16) & 0xFF] | // we start by shifting the third byte, since we only look at the first 21 bits
              morton256_y[(x[1] >> 16) & 0xFF] |
              morton256_x[(x[0] >> 16) & 0xFF];
-    answer = answer << 48 | morton256_z[(x[2] >> 8) & 0xFF] | // shifting second byte
+    answer = answer << 24 | morton256_z[(x[2] >> 8) & 0xFF] | // shifting second byte
              morton256_y[(x[1] >> 8) & 0xFF] |
              morton256_x[(x[0] >> 8) & 0xFF];
     answer = answer << 24 |
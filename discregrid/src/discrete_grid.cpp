@@ -1,4 +1,8 @@
 #include <discrete_grid.hpp>
+#include "data/morton.hpp"
+#include "data/radix_sort.hpp"
+
+#include <algorithm>
 
 using namespace Eigen;
 
@@ -38,4 +42,64 @@ namespace Discregrid
         return subdomain(singleToMultiIndex(l));
     }
 
+    unsigned int
+    DiscreteGrid::addFunction(BatchFunction const &func, bool verbose,
+                              SamplePredicate const &pred)
+    {
+        return addFunction(ContinuousFunction([&func](Vector3f const &x)
+                                              {
+                                                  auto value = 0.0f;
+                                                  func(1u, &x[0], &x[1], &x[2], &value);
+                                                  return value;
+                                              }),
+                           verbose, pred);
+    }
+
+    void
+    DiscreteGrid::interpolateBatch(unsigned int field_id, std::size_t n,
+                                   float const *xs, float const *ys, float const *zs, float *values,
+                                   float *gx, float *gy, float *gz) const
+    {
+        auto with_gradient = gx && gy && gz;
+
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < static_cast<int>(n); ++l)
+        {
+            auto x = Vector3f{xs[l], ys[l], zs[l]};
+            if (!with_gradient)
+            {
+                values[l] = interpolate(field_id, x);
+                continue;
+            }
+
+            auto gradient = Vector3f{};
+            values[l] = interpolate(field_id, x, &gradient);
+            gx[l] = gradient[0];
+            gy[l] = gradient[1];
+            gz[l] = gradient[2];
+        }
+    }
+
+    std::vector<unsigned int>
+    DiscreteGrid::zCurveOrder(std::size_t n, float const *xs, float const *ys, float const *zs) const
+    {
+        auto keys = std::vector<std::uint64_t>(n);
+        auto order = std::vector<unsigned int>(n);
+        auto encode = mortonEncoder();
+
+#pragma omp parallel for schedule(static)
+        for (int l = 0; l < static_cast<int>(n); ++l)
+        {
+            Vector3f x = (Vector3f{xs[l], ys[l], zs[l]} - m_domain.min()).cwiseProduct(m_inv_cell_size);
+            MultiIndex ijk;
+            for (auto d = 0u; d < 3u; ++d)
+                ijk[d] = x[d] > 0.0f ? std::min(static_cast<unsigned int>(x[d]), m_resolution[d] - 1) : 0u;
+            keys[l] = encode(ijk);
+            order[l] = static_cast<unsigned int>(l);
+        }
+
+        radixSort(keys, order);
+        return order;
+    }
+
 }
\ No newline at end of file
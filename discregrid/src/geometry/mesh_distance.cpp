@@ -1,8 +1,10 @@
 
 #include "point_triangle_distance.hpp"
+#include "../simd/triangle_distance.hpp"
 #include <geometry/mesh_distance.hpp>
 #include <mesh/triangle_mesh.hpp>
 
+#include <algorithm>
 #include <functional>
 #include <limits>
 #include <omp.h>
@@ -12,11 +14,117 @@ using namespace Eigen;
 namespace Discregrid
 {
 
-    MeshDistance::MeshDistance(TriangleMesh const &mesh, bool precompute_normals)
-        : m_mesh(mesh), m_bsh(mesh.vertex_data(), mesh.face_data()), m_precomputed_normals(precompute_normals)
+    namespace
+    {
+
+        // Number of entries of each array of the triangle data of n faces.
+        std::size_t
+        triangleStride(std::size_t n)
+        {
+            return n + simd::max_triangle_kernel_width - 1u;
+        }
+
+        simd::TriangleData
+        triangleData(std::vector<float> const &data, std::size_t n)
+        {
+            auto stride = triangleStride(n);
+            auto p = data.data();
+            return {{p, p + stride, p + 2 * stride},
+                    {p + 3 * stride, p + 4 * stride, p + 5 * stride},
+                    {p + 6 * stride, p + 7 * stride, p + 8 * stride},
+                    p + 9 * stride, p + 10 * stride, p + 11 * stride, p + 12 * stride, p + 13 * stride};
+        }
+
+        // Bounds of the distance between a point x and the faces enclosed by a hull.
+
+        // Lower bound, which orders the children of a node. Negative inside of spheres.
+        float
+        lowerBound(BoundingSphere const &hull, Vector3f const &x)
+        {
+            return (x - hull.x()).norm() - hull.r();
+        }
+
+        float
+        lowerBound(AlignedBox3f const &hull, Vector3f const &x)
+        {
+            return hull.exteriorDistance(x);
+        }
+
+        // Lower bound over all points in box.
+        float
+        lowerBound(BoundingSphere const &hull, AlignedBox3f const &box)
+        {
+            return box.exteriorDistance(hull.x()) - hull.r();
+        }
+
+        float
+        lowerBound(AlignedBox3f const &hull, AlignedBox3f const &box)
+        {
+            return (hull.min() - box.max()).cwiseMax(box.min() - hull.max()).cwiseMax(0.0f).norm();
+        }
+
+        // Returns whether the hull may enclose a face closer to x than dist, an upper bound of the
+        // distance of x to the mesh. Since the hull encloses at least one face, dist is tightened to
+        // the distance of the farthest point of the hull.
+        bool
+        reaches(BoundingSphere const &hull, Vector3f const &x, float &dist)
+        {
+            auto r = hull.r();
+            auto d_center2 = (x - hull.x()).squaredNorm();
+            if (dist > r)
+            {
+                auto l = dist - r;
+                if (l * l > d_center2)
+                    dist = std::sqrt(d_center2) + r;
+            }
+
+            auto d = dist + r;
+            return d_center2 <= d * d;
+        }
+
+        bool
+        reaches(AlignedBox3f const &hull, Vector3f const &x, float &dist)
+        {
+            // The farthest corner is often a vertex itself. Enlarged slightly, such that the face
+            // attaining the bound is still found to be closer despite round-off.
+            auto far2 = (1.0f + 1.0e-5f) * ((x - hull.center()).cwiseAbs() + 0.5f * hull.sizes()).squaredNorm();
+            if (far2 < dist * dist)
+                dist = std::sqrt(far2);
+
+            return hull.squaredExteriorDistance(x) <= dist * dist;
+        }
+
+        // Returns the squared lower bound of the distance between x and the faces enclosed by the
+        // hull. dist2, the squared distance of x to the closest face found so far, is tightened to
+        // that of the farthest point of the hull.
+        float
+        squaredLowerBound(BoundingSphere const &hull, Vector3f const &x, float &dist2)
+        {
+            auto d_center = (x - hull.x()).norm();
+            auto far = d_center + hull.r();
+            dist2 = std::min(dist2, far * far);
+            auto near = std::max(d_center - hull.r(), 0.0f);
+            return near * near;
+        }
+
+        float
+        squaredLowerBound(AlignedBox3f const &hull, Vector3f const &x, float &dist2)
+        {
+            // Enlarged as in reaches.
+            auto far2 = (1.0f + 1.0e-5f) * ((x - hull.center()).cwiseAbs() + 0.5f * hull.sizes()).squaredNorm();
+            dist2 = std::min(dist2, far2);
+            return hull.squaredExteriorDistance(x);
+        }
+
+    }
+
+    constexpr unsigned int MeshDistance::packet_size;
+
+    MeshDistance::MeshDistance(TriangleMesh const &mesh, bool precompute_normals, BoundingVolume bounding_volume,
+                               SplitStrategy split_strategy, unsigned int max_leaf_size)
+        : m_mesh(mesh), m_precomputed_normals(precompute_normals)
     {
         auto max_threads = omp_get_max_threads();
-        m_queues.resize(max_threads);
         m_nearest_face.resize(max_threads);
         m_cache.resize(max_threads, FunctionValueCache([&](Vector3f const &xi)
                                                        { return signedDistance(xi); },
@@ -25,7 +133,39 @@ namespace Discregrid
                                                         { return distance(xi); },
                                                         10000u));
 
-        m_bsh.construct();
+        if (bounding_volume == BoundingVolume::Sphere)
+        {
+            m_bsh.reset(new TriangleMeshBSH(mesh.vertex_data(), mesh.face_data()));
+            m_bsh->setSplitStrategy(split_strategy);
+            m_bsh->setMaxLeafSize(max_leaf_size);
+            m_bsh->construct();
+        }
+        else
+        {
+            m_bbh.reset(new TriangleMeshBBH(mesh.vertex_data(), mesh.face_data()));
+            m_bbh->setSplitStrategy(split_strategy);
+            m_bbh->setMaxLeafSize(max_leaf_size);
+            m_bbh->construct();
+        }
+
+        // The point independent terms of point_triangle_sqdistance are evaluated once per face.
+        auto stride = triangleStride(m_mesh.nFaces());
+        m_triangle_data.assign(14 * stride, 0.0f);
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < static_cast<int>(m_mesh.nFaces()); ++i)
+        {
+            auto f = m_bsh ? m_bsh->entity(i) : m_bbh->entity(i);
+            auto const &x0 = m_mesh.vertex(m_mesh.faceVertex(f, 0));
+            Vector3f edge0 = m_mesh.vertex(m_mesh.faceVertex(f, 1)) - x0;
+            Vector3f edge1 = m_mesh.vertex(m_mesh.faceVertex(f, 2)) - x0;
+            float a00 = edge0.dot(edge0);
+            float a01 = edge0.dot(edge1);
+            float a11 = edge1.dot(edge1);
+            auto values = std::array<float, 14>{{x0[0], x0[1], x0[2], edge0[0], edge0[1], edge0[2], edge1[0], edge1[1], edge1[2],
+                                                 a00, a01, a11, std::abs(a00 * a11 - a01 * a01), a00 - (2) * a01 + a11}};
+            for (auto j = 0u; j < 14u; ++j)
+                m_triangle_data[j * stride + i] = values[j];
+        }
 
         if (m_precomputed_normals)
         {
@@ -61,46 +201,61 @@ namespace Discregrid
     // Thread-safe.
     float
     MeshDistance::distance(Vector3f const &x, Vector3f *nearest_point,
-                           unsigned int *nearest_face, NearestEntity *ne) const
+                           unsigned int *nearest_face, NearestEntity *ne,
+                           QueryStatistics *statistics) const
     {
-        using namespace std::placeholders;
+        if (m_bsh)
+            return distance(*m_bsh, x, nearest_point, nearest_face, ne, statistics);
+        return distance(*m_bbh, x, nearest_point, nearest_face, ne, statistics);
+    }
 
-        auto dist_candidate = std::numeric_limits<float>::max();
-        auto f = m_nearest_face[omp_get_thread_num()];
+    template <typename Hierarchy>
+    float
+    MeshDistance::distance(Hierarchy const &hierarchy, Vector3f const &x, Vector3f *nearest_point,
+                           unsigned int *nearest_face, NearestEntity *ne,
+                           QueryStatistics *statistics) const
+    {
+        auto &f = m_nearest_face[omp_get_thread_num()];
+        auto dist2 = std::numeric_limits<float>::max();
         if (f < m_mesh.nFaces())
         {
             auto t = std::array<Vector3f const *, 3>{
                 &m_mesh.vertex(m_mesh.faceVertex(f, 0)),
                 &m_mesh.vertex(m_mesh.faceVertex(f, 1)),
                 &m_mesh.vertex(m_mesh.faceVertex(f, 2))};
-            dist_candidate = std::sqrt(point_triangle_sqdistance(x, t));
+            dist2 = point_triangle_sqdistance(x, t);
         }
 
-        auto pred = [&](unsigned int node_index, unsigned int)
+        auto key = [&](unsigned int node_index)
         {
-            return predicate(node_index, m_bsh, x, dist_candidate);
+            return squaredLowerBound(hierarchy.flatNode(node_index).hull, x, dist2);
         };
 
+        auto triangles = triangleData(m_triangle_data, m_mesh.nFaces());
+        auto const &kernel = simd::pointTriangleKernel();
         auto cb = [&](unsigned int node_index, unsigned int)
         {
-            return callback(node_index, m_bsh, x, dist_candidate);
-        };
-
-        auto pless = [&](std::array<int, 2> const &c)
-        {
-            //return true;
-            auto const &hull0 = m_bsh.hull(c[0]);
-            auto const &hull1 = m_bsh.hull(c[1]);
-            auto d0_2 = (x - hull0.x()).norm() - hull0.r();
-            auto d1_2 = (x - hull1.x()).norm() - hull1.r();
-            return d0_2 < d1_2;
+            auto const &node = hierarchy.flatNode(node_index);
+            if (statistics)
+                ++statistics->nodes_visited;
+            if (!node.isLeaf())
+                return;
+
+            auto i = 0u;
+            auto leaf_dist2 = kernel.evaluate(triangles, node.index, node.n, x.data(), &i, nullptr);
+            if (leaf_dist2 < dist2)
+            {
+                dist2 = leaf_dist2;
+                f = hierarchy.entity(i);
+            }
+            if (statistics)
+                statistics->triangles_tested += node.n;
         };
 
-        while (!m_queues[omp_get_thread_num()].empty())
-            m_queues[omp_get_thread_num()].pop();
-        m_bsh.traverseDepthFirst(pred, cb, pless);
+        hierarchy.traverseBestFirst(key, cb, dist2);
+        if (statistics)
+            ++statistics->n_queries;
 
-        f = m_nearest_face[omp_get_thread_num()];
         if (nearest_point)
         {
             auto t = std::array<Vector3f const *, 3>{
@@ -109,8 +264,7 @@ namespace Discregrid
                 &m_mesh.vertex(m_mesh.faceVertex(f, 2))};
             auto np = Vector3f{};
             auto ne_ = NearestEntity{};
-            auto dist2_ = point_triangle_sqdistance(x, t, &np, &ne_);
-            dist_candidate = std::sqrt(dist2_);
+            dist2 = point_triangle_sqdistance(x, t, &np, &ne_);
             if (ne)
                 *ne = ne_;
             if (nearest_point)
@@ -118,84 +272,27 @@ namespace Discregrid
         }
         if (nearest_face)
             *nearest_face = f;
-        return dist_candidate;
-    }
-
-    bool
-    MeshDistance::predicate(unsigned int node_index,
-                            TriangleMeshBSH const &bsh,
-                            Vector3f const &x,
-                            float &dist_candidate) const
-    {
-        // If the furthest point on the current candidate hull is closer than the closest point on the next hull then we can skip it
-        auto const &hull = bsh.hull(node_index);
-        auto const &hull_radius = hull.r();
-        auto const &hull_center = hull.x();
-
-        const auto dist_sq_to_center = (x - hull_center).squaredNorm();
-
-        if (dist_candidate > hull_radius)
-        {
-            const auto l = dist_candidate - hull_radius;
-            if (l * l > dist_sq_to_center)
-                dist_candidate = std::sqrt(dist_sq_to_center) + hull_radius;
-        }
-
-        const auto d = dist_candidate + hull_radius;
-        return dist_sq_to_center <= d * d;
+        return std::sqrt(dist2);
     }
 
-    void
-    MeshDistance::callback(unsigned int node_index,
-                           TriangleMeshBSH const &bsh,
-                           Vector3f const &x,
-                           float &dist_candidate) const
+    float
+    MeshDistance::signedDistance(Vector3f const &x) const
     {
-        auto const &node = m_bsh.node(node_index);
-        auto const &hull = m_bsh.hull(node_index);
-
-        if (!node.isLeaf())
-            return;
-
-        auto r = hull.r();
-
-        auto temp = (x - hull.x()).eval();
-        auto d_center2 = temp[0] * temp[0] + temp[1] * temp[1] + temp[2] * temp[2];
-
-        auto temp_ = dist_candidate + r;
-        if (d_center2 > temp_ * temp_)
-            return;
-
-        auto dist_candidate_2 = dist_candidate * dist_candidate;
-        auto changed = false;
-        for (auto i = node.begin; i < node.begin + node.n; ++i)
-        {
-            auto f = m_bsh.entity(i);
-            auto t = std::array<Vector3f const *, 3>{
-                &m_mesh.vertex(m_mesh.faceVertex(f, 0)),
-                &m_mesh.vertex(m_mesh.faceVertex(f, 1)),
-                &m_mesh.vertex(m_mesh.faceVertex(f, 2))};
-            auto dist2_ = point_triangle_sqdistance(x, t);
-            if (dist_candidate_2 > dist2_)
-            {
-                dist_candidate_2 = dist2_;
-                changed = true;
-                m_nearest_face[omp_get_thread_num()] = f;
-            }
-        }
-        if (changed)
-        {
-            dist_candidate = std::sqrt(dist_candidate_2);
-        }
+        unsigned int nf;
+        distance(x, nullptr, &nf);
+        return signedDistance(x, nf);
     }
 
     float
-    MeshDistance::signedDistance(Vector3f const &x) const
+    MeshDistance::signedDistance(Vector3f const &x, unsigned int nf) const
     {
-        unsigned int nf;
+        auto t = std::array<Vector3f const *, 3>{
+            &m_mesh.vertex(m_mesh.faceVertex(nf, 0)),
+            &m_mesh.vertex(m_mesh.faceVertex(nf, 1)),
+            &m_mesh.vertex(m_mesh.faceVertex(nf, 2))};
         auto ne = NearestEntity{};
         auto np = Vector3f{};
-        auto dist = distance(x, &np, &nf, &ne);
+        auto dist = std::sqrt(point_triangle_sqdistance(x, t, &np, &ne));
 
         auto n = Vector3f{};
         switch (ne)
@@ -250,6 +347,140 @@ namespace Discregrid
         return m_ucache[omp_get_thread_num()](x);
     }
 
+    void
+    MeshDistance::distanceBatch(std::size_t n, float const *xs, float const *ys, float const *zs,
+                                float *distances, unsigned int *nearest_faces) const
+    {
+        auto x = std::array<Vector3f, packet_size>{};
+        auto faces = std::array<unsigned int, packet_size>{};
+        auto stack = std::vector<PacketItem>{};
+        stack.reserve(64u);
+
+        // The closest face of the last point of a packet is likely close to the points of the next.
+        auto warm_face = std::numeric_limits<unsigned int>::max();
+        for (auto b = std::size_t{0}; b < n; b += packet_size)
+        {
+            auto m = static_cast<unsigned int>(std::min(n - b, std::size_t{packet_size}));
+            for (auto i = 0u; i < m; ++i)
+                x[i] = Vector3f(xs[b + i], ys[b + i], zs[b + i]);
+
+            if (m_bsh)
+                distancePacket(*m_bsh, m, x.data(), warm_face, stack, distances + b, faces.data());
+            else
+                distancePacket(*m_bbh, m, x.data(), warm_face, stack, distances + b, faces.data());
+
+            if (nearest_faces)
+                std::copy(faces.begin(), faces.begin() + m, nearest_faces + b);
+            warm_face = faces[m - 1u];
+        }
+    }
+
+    void
+    MeshDistance::signedDistanceBatch(std::size_t n, float const *xs, float const *ys, float const *zs,
+                                      float *distances) const
+    {
+        auto faces = std::vector<unsigned int>(n);
+        distanceBatch(n, xs, ys, zs, distances, faces.data());
+        for (auto i = 0u; i < n; ++i)
+            distances[i] = signedDistance(Vector3f(xs[i], ys[i], zs[i]), faces[i]);
+    }
+
+    template <typename Hierarchy>
+    void
+    MeshDistance::distancePacket(Hierarchy const &hierarchy, unsigned int n, Vector3f const *x,
+                                 unsigned int warm_face, std::vector<PacketItem> &stack, float *dist,
+                                 unsigned int *nearest_face) const
+    {
+        // For each point, dist holds an upper bound of its distance to the mesh, derived from the
+        // closest face found so far or from the farthest point of a visited hull, and dist2 the
+        // squared distance to nearest_face.
+        auto dist2 = std::array<float, packet_size>{};
+        auto box = AlignedBox3f{};
+        for (auto i = 0u; i < n; ++i)
+        {
+            box.extend(x[i]);
+            dist[i] = std::numeric_limits<float>::max();
+            dist2[i] = std::numeric_limits<float>::max();
+            nearest_face[i] = std::numeric_limits<unsigned int>::max();
+        }
+
+        if (warm_face < m_mesh.nFaces())
+        {
+            auto t = std::array<Vector3f const *, 3>{
+                &m_mesh.vertex(m_mesh.faceVertex(warm_face, 0)),
+                &m_mesh.vertex(m_mesh.faceVertex(warm_face, 1)),
+                &m_mesh.vertex(m_mesh.faceVertex(warm_face, 2))};
+            for (auto i = 0u; i < n; ++i)
+            {
+                dist2[i] = point_triangle_sqdistance(x[i], t);
+                dist[i] = std::sqrt(dist2[i]);
+                nearest_face[i] = warm_face;
+            }
+        }
+        auto max_dist = *std::max_element(dist, dist + n);
+        auto center = box.center().eval();
+        auto const triangles = triangleData(m_triangle_data, m_mesh.nFaces());
+        auto const kernel = simd::pointTriangleKernel().evaluate;
+
+        stack.clear();
+        stack.push_back({0u, n == 64u ? ~std::uint64_t{0} : (std::uint64_t{1} << n) - 1u});
+        while (!stack.empty())
+        {
+            auto item = stack.back();
+            stack.pop_back();
+
+            auto const &node = hierarchy.flatNode(item.node_index);
+            auto const &hull = node.hull;
+
+            // Conservative test for the whole packet before the points are tested individually.
+            if (lowerBound(hull, box) > max_dist)
+                continue;
+
+            // Points whose distance bound does not reach the hull cannot find a closer face in the
+            // subtree, since the hulls of the children enclose subsets of the faces of this hull.
+            auto active = std::uint64_t{0};
+            for (auto i = 0u; i < n; ++i)
+            {
+                if (!(item.active & (std::uint64_t{1} << i)))
+                    continue;
+                if (reaches(hull, x[i], dist[i]))
+                    active |= std::uint64_t{1} << i;
+            }
+            if (!active)
+                continue;
+
+            if (!node.isLeaf())
+            {
+                // The child closer to the packet is visited first.
+                auto children = std::array<unsigned int, 2>{{item.node_index + 1u, node.index}};
+                auto d0 = lowerBound(hierarchy.flatNode(children[0]).hull, center);
+                auto d1 = lowerBound(hierarchy.flatNode(children[1]).hull, center);
+                auto first = d0 < d1 ? 0u : 1u;
+                stack.push_back({children[1u - first], active});
+                stack.push_back({children[first], active});
+                continue;
+            }
+
+            for (auto i = 0u; i < n; ++i)
+            {
+                if (!(active & (std::uint64_t{1} << i)))
+                    continue;
+                auto j = 0u;
+                auto d2 = kernel(triangles, node.index, node.n, x[i].data(), &j, nullptr);
+                if (dist2[i] > d2)
+                {
+                    dist2[i] = d2;
+                    nearest_face[i] = hierarchy.entity(j);
+                    dist[i] = std::min(dist[i], std::sqrt(d2));
+                }
+            }
+            max_dist = *std::max_element(dist, dist + n);
+        }
+
+        for (auto i = 0u; i < n; ++i)
+            dist[i] = std::sqrt(dist2[i]);
+    }
+
     Vector3f
     MeshDistance::face_normal(unsigned int f) const
     {
@@ -0,0 +1,262 @@
+#pragma once
+
+// Generic, lane-parallel evaluation of the 32 cubic serendipity shape functions and their
+// derivatives. The kernel is written once against a minimal vector interface V and instantiated
+// per instruction set in the shape_functions_*.cpp translation units, which are compiled with the
+// respective target flags. This header must therefore not include any other header whose inline
+// functions could be emitted with those flags.
+//
+// Required interface of V:
+//   static constexpr unsigned int width;   number of lanes
+//   V(float);                              broadcast
+//   static V load(float const *);          unaligned load of width floats
+//   static void store(float *, V);         unaligned store of width floats
+//   +, -, * between V and V or float, unary -
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        // Evaluates the shape functions N and their derivatives dN at the local coordinates
+        // (xi, yi, zi) in [-1, 1]^3 of V::width points. The results are stored lane-major, i.e.
+        // N[j * V::width + lane] and dN[(d * 32 + j) * V::width + lane] for dimension d. dN may be null.
+        template <typename V>
+        inline void
+        shapeFunctions(float const *xi, float const *yi, float const *zi, float *N, float *dN)
+        {
+            V const x = V::load(xi);
+            V const y = V::load(yi);
+            V const z = V::load(zi);
+
+            V const x2 = x * x;
+            V const y2 = y * y;
+            V const z2 = z * z;
+
+            V const _1mx = 1.0f - x;
+            V const _1my = 1.0f - y;
+            V const _1mz = 1.0f - z;
+
+            V const _1px = 1.0f + x;
+            V const _1py = 1.0f + y;
+            V const _1pz = 1.0f + z;
+
+            V const _1m3x = 1.0f - 3.0f * x;
+            V const _1m3y = 1.0f - 3.0f * y;
+            V const _1m3z = 1.0f - 3.0f * z;
+
+            V const _1p3x = 1.0f + 3.0f * x;
+            V const _1p3y = 1.0f + 3.0f * y;
+            V const _1p3z = 1.0f + 3.0f * z;
+
+            V const _1mxt1my = _1mx * _1my;
+            V const _1mxt1py = _1mx * _1py;
+            V const _1pxt1my = _1px * _1my;
+            V const _1pxt1py = _1px * _1py;
+
+            V const _1mxt1mz = _1mx * _1mz;
+            V const _1mxt1pz = _1mx * _1pz;
+            V const _1pxt1mz = _1px * _1mz;
+            V const _1pxt1pz = _1px * _1pz;
+
+            V const _1myt1mz = _1my * _1mz;
+            V const _1myt1pz = _1my * _1pz;
+            V const _1pyt1mz = _1py * _1mz;
+            V const _1pyt1pz = _1py * _1pz;
+
+            V const _1mx2 = 1.0f - x2;
+            V const _1my2 = 1.0f - y2;
+            V const _1mz2 = 1.0f - z2;
+
+            // Corner nodes.
+            V fac = 1.0f / 64.0f * (9.0f * (x2 + y2 + z2) - 19.0f);
+            V::store(N + 0 * V::width, fac * _1mxt1my * _1mz);
+            V::store(N + 1 * V::width, fac * _1pxt1my * _1mz);
+            V::store(N + 2 * V::width, fac * _1mxt1py * _1mz);
+            V::store(N + 3 * V::width, fac * _1pxt1py * _1mz);
+            V::store(N + 4 * V::width, fac * _1mxt1my * _1pz);
+            V::store(N + 5 * V::width, fac * _1pxt1my * _1pz);
+            V::store(N + 6 * V::width, fac * _1mxt1py * _1pz);
+            V::store(N + 7 * V::width, fac * _1pxt1py * _1pz);
+
+            // Edge nodes.
+
+            fac = 9.0f / 64.0f * _1mx2;
+            V const fact1m3x = fac * _1m3x;
+            V const fact1p3x = fac * _1p3x;
+            V::store(N + 8 * V::width, fact1m3x * _1myt1mz);
+            V::store(N + 9 * V::width, fact1p3x * _1myt1mz);
+            V::store(N + 10 * V::width, fact1m3x * _1myt1pz);
+            V::store(N + 11 * V::width, fact1p3x * _1myt1pz);
+            V::store(N + 12 * V::width, fact1m3x * _1pyt1mz);
+            V::store(N + 13 * V::width, fact1p3x * _1pyt1mz);
+            V::store(N + 14 * V::width, fact1m3x * _1pyt1pz);
+            V::store(N + 15 * V::width, fact1p3x * _1pyt1pz);
+
+            fac = 9.0f / 64.0f * _1my2;
+            V const fact1m3y = fac * _1m3y;
+            V const fact1p3y = fac * _1p3y;
+            V::store(N + 16 * V::width, fact1m3y * _1mxt1mz);
+            V::store(N + 17 * V::width, fact1p3y * _1mxt1mz);
+            V::store(N + 18 * V::width, fact1m3y * _1pxt1mz);
+            V::store(N + 19 * V::width, fact1p3y * _1pxt1mz);
+            V::store(N + 20 * V::width, fact1m3y * _1mxt1pz);
+            V::store(N + 21 * V::width, fact1p3y * _1mxt1pz);
+            V::store(N + 22 * V::width, fact1m3y * _1pxt1pz);
+            V::store(N + 23 * V::width, fact1p3y * _1pxt1pz);
+
+            fac = 9.0f / 64.0f * _1mz2;
+            V const fact1m3z = fac * _1m3z;
+            V const fact1p3z = fac * _1p3z;
+            V::store(N + 24 * V::width, fact1m3z * _1mxt1my);
+            V::store(N + 25 * V::width, fact1p3z * _1mxt1my);
+            V::store(N + 26 * V::width, fact1m3z * _1mxt1py);
+            V::store(N + 27 * V::width, fact1p3z * _1mxt1py);
+            V::store(N + 28 * V::width, fact1m3z * _1pxt1my);
+            V::store(N + 29 * V::width, fact1p3z * _1pxt1my);
+            V::store(N + 30 * V::width, fact1m3z * _1pxt1py);
+            V::store(N + 31 * V::width, fact1p3z * _1pxt1py);
+
+            if (!dN)
+                return;
+
+            V const c64 = V(1.0f / 64.0f);
+            V const c9_64 = V(9.0f / 64.0f);
+
+            V const _9t3x2py2pz2m19 = 9.0f * (3.0f * x2 + y2 + z2) - 19.0f;
+            V const _9tx2p3y2pz2m19 = 9.0f * (x2 + 3.0f * y2 + z2) - 19.0f;
+            V const _9tx2py2p3z2m19 = 9.0f * (x2 + y2 + 3.0f * z2) - 19.0f;
+            V const _18x = 18.0f * x;
+            V const _18y = 18.0f * y;
+            V const _18z = 18.0f * z;
+
+            V const _3m9x2 = 3.0f - 9.0f * x2;
+            V const _3m9y2 = 3.0f - 9.0f * y2;
+            V const _3m9z2 = 3.0f - 9.0f * z2;
+
+            V const _2x = 2.0f * x;
+            V const _2y = 2.0f * y;
+            V const _2z = 2.0f * z;
+
+            V const _18xm9t3x2py2pz2m19 = _18x - _9t3x2py2pz2m19;
+            V const _18xp9t3x2py2pz2m19 = _18x + _9t3x2py2pz2m19;
+            V const _18ym9tx2p3y2pz2m19 = _18y - _9tx2p3y2pz2m19;
+            V const _18yp9tx2p3y2pz2m19 = _18y + _9tx2p3y2pz2m19;
+            V const _18zm9tx2py2p3z2m19 = _18z - _9tx2py2p3z2m19;
+            V const _18zp9tx2py2p3z2m19 = _18z + _9tx2py2p3z2m19;
+
+            V::store(dN + 0 * V::width, c64 * (_18xm9t3x2py2pz2m19 * _1myt1mz));
+            V::store(dN + 32 * V::width, c64 * (_1mxt1mz * _18ym9tx2p3y2pz2m19));
+            V::store(dN + 64 * V::width, c64 * (_1mxt1my * _18zm9tx2py2p3z2m19));
+            V::store(dN + 1 * V::width, c64 * (_18xp9t3x2py2pz2m19 * _1myt1mz));
+            V::store(dN + 33 * V::width, c64 * (_1pxt1mz * _18ym9tx2p3y2pz2m19));
+            V::store(dN + 65 * V::width, c64 * (_1pxt1my * _18zm9tx2py2p3z2m19));
+            V::store(dN + 2 * V::width, c64 * (_18xm9t3x2py2pz2m19 * _1pyt1mz));
+            V::store(dN + 34 * V::width, c64 * (_1mxt1mz * _18yp9tx2p3y2pz2m19));
+            V::store(dN + 66 * V::width, c64 * (_1mxt1py * _18zm9tx2py2p3z2m19));
+            V::store(dN + 3 * V::width, c64 * (_18xp9t3x2py2pz2m19 * _1pyt1mz));
+            V::store(dN + 35 * V::width, c64 * (_1pxt1mz * _18yp9tx2p3y2pz2m19));
+            V::store(dN + 67 * V::width, c64 * (_1pxt1py * _18zm9tx2py2p3z2m19));
+            V::store(dN + 4 * V::width, c64 * (_18xm9t3x2py2pz2m19 * _1myt1pz));
+            V::store(dN + 36 * V::width, c64 * (_1mxt1pz * _18ym9tx2p3y2pz2m19));
+            V::store(dN + 68 * V::width, c64 * (_1mxt1my * _18zp9tx2py2p3z2m19));
+            V::store(dN + 5 * V::width, c64 * (_18xp9t3x2py2pz2m19 * _1myt1pz));
+            V::store(dN + 37 * V::width, c64 * (_1pxt1pz * _18ym9tx2p3y2pz2m19));
+            V::store(dN + 69 * V::width, c64 * (_1pxt1my * _18zp9tx2py2p3z2m19));
+            V::store(dN + 6 * V::width, c64 * (_18xm9t3x2py2pz2m19 * _1pyt1pz));
+            V::store(dN + 38 * V::width, c64 * (_1mxt1pz * _18yp9tx2p3y2pz2m19));
+            V::store(dN + 70 * V::width, c64 * (_1mxt1py * _18zp9tx2py2p3z2m19));
+            V::store(dN + 7 * V::width, c64 * (_18xp9t3x2py2pz2m19 * _1pyt1pz));
+            V::store(dN + 39 * V::width, c64 * (_1pxt1pz * _18yp9tx2p3y2pz2m19));
+            V::store(dN + 71 * V::width, c64 * (_1pxt1py * _18zp9tx2py2p3z2m19));
+
+            V const _m3m9x2m2x = -_3m9x2 - _2x;
+            V const _p3m9x2m2x = _3m9x2 - _2x;
+            V const _1mx2t1m3x = _1mx2 * _1m3x;
+            V const _1mx2t1p3x = _1mx2 * _1p3x;
+            V::store(dN + 8 * V::width, c9_64 * (_m3m9x2m2x * _1myt1mz));
+            V::store(dN + 40 * V::width, c9_64 * (-_1mx2t1m3x * _1mz));
+            V::store(dN + 72 * V::width, c9_64 * (-_1mx2t1m3x * _1my));
+            V::store(dN + 9 * V::width, c9_64 * (_p3m9x2m2x * _1myt1mz));
+            V::store(dN + 41 * V::width, c9_64 * (-_1mx2t1p3x * _1mz));
+            V::store(dN + 73 * V::width, c9_64 * (-_1mx2t1p3x * _1my));
+            V::store(dN + 10 * V::width, c9_64 * (_m3m9x2m2x * _1myt1pz));
+            V::store(dN + 42 * V::width, c9_64 * (-_1mx2t1m3x * _1pz));
+            V::store(dN + 74 * V::width, c9_64 * (_1mx2t1m3x * _1my));
+            V::store(dN + 11 * V::width, c9_64 * (_p3m9x2m2x * _1myt1pz));
+            V::store(dN + 43 * V::width, c9_64 * (-_1mx2t1p3x * _1pz));
+            V::store(dN + 75 * V::width, c9_64 * (_1mx2t1p3x * _1my));
+            V::store(dN + 12 * V::width, c9_64 * (_m3m9x2m2x * _1pyt1mz));
+            V::store(dN + 44 * V::width, c9_64 * (_1mx2t1m3x * _1mz));
+            V::store(dN + 76 * V::width, c9_64 * (-_1mx2t1m3x * _1py));
+            V::store(dN + 13 * V::width, c9_64 * (_p3m9x2m2x * _1pyt1mz));
+            V::store(dN + 45 * V::width, c9_64 * (_1mx2t1p3x * _1mz));
+            V::store(dN + 77 * V::width, c9_64 * (-_1mx2t1p3x * _1py));
+            V::store(dN + 14 * V::width, c9_64 * (_m3m9x2m2x * _1pyt1pz));
+            V::store(dN + 46 * V::width, c9_64 * (_1mx2t1m3x * _1pz));
+            V::store(dN + 78 * V::width, c9_64 * (_1mx2t1m3x * _1py));
+            V::store(dN + 15 * V::width, c9_64 * (_p3m9x2m2x * _1pyt1pz));
+            V::store(dN + 47 * V::width, c9_64 * (_1mx2t1p3x * _1pz));
+            V::store(dN + 79 * V::width, c9_64 * (_1mx2t1p3x * _1py));
+
+            V const _m3m9y2m2y = -_3m9y2 - _2y;
+            V const _p3m9y2m2y = _3m9y2 - _2y;
+            V const _1my2t1m3y = _1my2 * _1m3y;
+            V const _1my2t1p3y = _1my2 * _1p3y;
+            V::store(dN + 16 * V::width, c9_64 * (-_1my2t1m3y * _1mz));
+            V::store(dN + 48 * V::width, c9_64 * (_m3m9y2m2y * _1mxt1mz));
+            V::store(dN + 80 * V::width, c9_64 * (-_1my2t1m3y * _1mx));
+            V::store(dN + 17 * V::width, c9_64 * (-_1my2t1p3y * _1mz));
+            V::store(dN + 49 * V::width, c9_64 * (_p3m9y2m2y * _1mxt1mz));
+            V::store(dN + 81 * V::width, c9_64 * (-_1my2t1p3y * _1mx));
+            V::store(dN + 18 * V::width, c9_64 * (_1my2t1m3y * _1mz));
+            V::store(dN + 50 * V::width, c9_64 * (_m3m9y2m2y * _1pxt1mz));
+            V::store(dN + 82 * V::width, c9_64 * (-_1my2t1m3y * _1px));
+            V::store(dN + 19 * V::width, c9_64 * (_1my2t1p3y * _1mz));
+            V::store(dN + 51 * V::width, c9_64 * (_p3m9y2m2y * _1pxt1mz));
+            V::store(dN + 83 * V::width, c9_64 * (-_1my2t1p3y * _1px));
+            V::store(dN + 20 * V::width, c9_64 * (-_1my2t1m3y * _1pz));
+            V::store(dN + 52 * V::width, c9_64 * (_m3m9y2m2y * _1mxt1pz));
+            V::store(dN + 84 * V::width, c9_64 * (_1my2t1m3y * _1mx));
+            V::store(dN + 21 * V::width, c9_64 * (-_1my2t1p3y * _1pz));
+            V::store(dN + 53 * V::width, c9_64 * (_p3m9y2m2y * _1mxt1pz));
+            V::store(dN + 85 * V::width, c9_64 * (_1my2t1p3y * _1mx));
+            V::store(dN + 22 * V::width, c9_64 * (_1my2t1m3y * _1pz));
+            V::store(dN + 54 * V::width, c9_64 * (_m3m9y2m2y * _1pxt1pz));
+            V::store(dN + 86 * V::width, c9_64 * (_1my2t1m3y * _1px));
+            V::store(dN + 23 * V::width, c9_64 * (_1my2t1p3y * _1pz));
+            V::store(dN + 55 * V::width, c9_64 * (_p3m9y2m2y * _1pxt1pz));
+            V::store(dN + 87 * V::width, c9_64 * (_1my2t1p3y * _1px));
+
+            V const _m3m9z2m2z = -_3m9z2 - _2z;
+            V const _p3m9z2m2z = _3m9z2 - _2z;
+            V const _1mz2t1m3z = _1mz2 * _1m3z;
+            V const _1mz2t1p3z = _1mz2 * _1p3z;
+            V::store(dN + 24 * V::width, c9_64 * (-_1mz2t1m3z * _1my));
+            V::store(dN + 56 * V::width, c9_64 * (-_1mz2t1m3z * _1mx));
+            V::store(dN + 88 * V::width, c9_64 * (_m3m9z2m2z * _1mxt1my));
+            V::store(dN + 25 * V::width, c9_64 * (-_1mz2t1p3z * _1my));
+            V::store(dN + 57 * V::width, c9_64 * (-_1mz2t1p3z * _1mx));
+            V::store(dN + 89 * V::width, c9_64 * (_p3m9z2m2z * _1mxt1my));
+            V::store(dN + 26 * V::width, c9_64 * (-_1mz2t1m3z * _1py));
+            V::store(dN + 58 * V::width, c9_64 * (_1mz2t1m3z * _1mx));
+            V::store(dN + 90 * V::width, c9_64 * (_m3m9z2m2z * _1mxt1py));
+            V::store(dN + 27 * V::width, c9_64 * (-_1mz2t1p3z * _1py));
+            V::store(dN + 59 * V::width, c9_64 * (_1mz2t1p3z * _1mx));
+            V::store(dN + 91 * V::width, c9_64 * (_p3m9z2m2z * _1mxt1py));
+            V::store(dN + 28 * V::width, c9_64 * (_1mz2t1m3z * _1my));
+            V::store(dN + 60 * V::width, c9_64 * (-_1mz2t1m3z * _1px));
+            V::store(dN + 92 * V::width, c9_64 * (_m3m9z2m2z * _1pxt1my));
+            V::store(dN + 29 * V::width, c9_64 * (_1mz2t1p3z * _1my));
+            V::store(dN + 61 * V::width, c9_64 * (-_1mz2t1p3z * _1px));
+            V::store(dN + 93 * V::width, c9_64 * (_p3m9z2m2z * _1pxt1my));
+            V::store(dN + 30 * V::width, c9_64 * (_1mz2t1m3z * _1py));
+            V::store(dN + 62 * V::width, c9_64 * (_1mz2t1m3z * _1px));
+            V::store(dN + 94 * V::width, c9_64 * (_m3m9z2m2z * _1pxt1py));
+            V::store(dN + 31 * V::width, c9_64 * (_1mz2t1p3z * _1py));
+            V::store(dN + 63 * V::width, c9_64 * (_1mz2t1p3z * _1px));
+            V::store(dN + 95 * V::width, c9_64 * (_p3m9z2m2z * _1pxt1py));
+        }
+
+    } // namespace simd
+} // namespace Discregrid
@@ -0,0 +1,71 @@
+#include "shape_functions.hpp"
+#include "shape_function_kernel.hpp"
+#include "../utility/cpu_features.hpp"
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        namespace
+        {
+
+            // Single-lane fallback for targets without a vectorized kernel.
+            struct Scalar
+            {
+                static constexpr unsigned int width = 1u;
+
+                Scalar(float v_) : v(v_) {}
+
+                static Scalar load(float const *p) { return *p; }
+                static void store(float *p, Scalar a) { *p = a.v; }
+
+                float v;
+            };
+
+            inline Scalar operator+(Scalar a, Scalar b) { return a.v + b.v; }
+            inline Scalar operator-(Scalar a, Scalar b) { return a.v - b.v; }
+            inline Scalar operator*(Scalar a, Scalar b) { return a.v * b.v; }
+            inline Scalar operator-(Scalar a) { return -a.v; }
+
+            void
+            shapeFunctionsScalar(float const *xi, float const *yi, float const *zi, float *N, float *dN)
+            {
+                shapeFunctions<Scalar>(xi, yi, zi, N, dN);
+            }
+
+            ShapeFunctionKernelInfo
+            selectKernel()
+            {
+                auto const scalar = ShapeFunctionKernelInfo{shapeFunctionsScalar, 1u, "scalar"};
+#if defined(DISCREGRID_SIMD_X86)
+                auto const sse = ShapeFunctionKernelInfo{shapeFunctionsSSE, 4u, "sse"};
+                auto const avx2 = ShapeFunctionKernelInfo{shapeFunctionsAVX2, 8u, "avx2"};
+                auto const avx512 = ShapeFunctionKernelInfo{shapeFunctionsAVX512, 16u, "avx512"};
+
+                switch (simdLevel(SimdLevel::AVX512))
+                {
+                case SimdLevel::AVX512:
+                    return avx512;
+                case SimdLevel::AVX2:
+                    return avx2;
+                case SimdLevel::SSE:
+                    return sse;
+                default:
+                    break;
+                }
+#endif
+                return scalar;
+            }
+
+        } // namespace
+
+        ShapeFunctionKernelInfo const &
+        shapeFunctionKernel()
+        {
+            static ShapeFunctionKernelInfo const kernel = selectKernel();
+            return kernel;
+        }
+
+    } // namespace simd
+} // namespace Discregrid
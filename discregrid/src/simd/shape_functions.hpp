@@ -0,0 +1,34 @@
+#pragma once
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        // Evaluates the 32 shape functions (and optionally their derivatives) for a block of points
+        // in local cell coordinates. See shapeFunctions() in shape_function_kernel.hpp for the layout.
+        using ShapeFunctionKernel = void (*)(float const *xi, float const *yi, float const *zi,
+                                             float *N, float *dN);
+
+        struct ShapeFunctionKernelInfo
+        {
+            ShapeFunctionKernel evaluate;
+            unsigned int width;
+            char const *name;
+        };
+
+        // Largest block size of any kernel. Callers size their lane-major buffers accordingly.
+        unsigned int const max_kernel_width = 16u;
+
+        // Returns the widest kernel supported by the executing CPU. The choice can be overridden by
+        // setting the environment variable DISCREGRID_SIMD to one of scalar, sse, avx2 or avx512.
+        ShapeFunctionKernelInfo const &shapeFunctionKernel();
+
+#if defined(DISCREGRID_SIMD_X86)
+        void shapeFunctionsSSE(float const *xi, float const *yi, float const *zi, float *N, float *dN);
+        void shapeFunctionsAVX2(float const *xi, float const *yi, float const *zi, float *N, float *dN);
+        void shapeFunctionsAVX512(float const *xi, float const *yi, float const *zi, float *N, float *dN);
+#endif
+
+    } // namespace simd
+} // namespace Discregrid
@@ -0,0 +1,46 @@
+// Compiled with AVX2 and FMA enabled. Do not include headers other than the intrinsics and the kernel.
+#include "shape_functions.hpp"
+#include "shape_function_kernel.hpp"
+
+#include <immintrin.h>
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        namespace
+        {
+
+            struct Vec
+            {
+                static constexpr unsigned int width = 8u;
+
+                Vec(__m256 v_) : v(v_) {}
+                Vec(float s) : v(_mm256_set1_ps(s)) {}
+
+                static Vec load(float const *p) { return _mm256_loadu_ps(p); }
+                static void store(float *p, Vec a) { _mm256_storeu_ps(p, a.v); }
+
+                __m256 v;
+            };
+
+            inline Vec operator+(Vec a, Vec b) { return _mm256_add_ps(a.v, b.v); }
+            inline Vec operator-(Vec a, Vec b) { return _mm256_sub_ps(a.v, b.v); }
+            inline Vec operator*(Vec a, Vec b) { return _mm256_mul_ps(a.v, b.v); }
+            inline Vec operator-(Vec a) { return _mm256_sub_ps(_mm256_setzero_ps(), a.v); }
+            inline Vec operator+(float a, Vec b) { return Vec(a) + b; }
+            inline Vec operator-(float a, Vec b) { return Vec(a) - b; }
+            inline Vec operator*(float a, Vec b) { return Vec(a) * b; }
+            inline Vec operator-(Vec a, float b) { return a - Vec(b); }
+
+        } // namespace
+
+        void
+        shapeFunctionsAVX2(float const *xi, float const *yi, float const *zi, float *N, float *dN)
+        {
+            shapeFunctions<Vec>(xi, yi, zi, N, dN);
+        }
+
+    } // namespace simd
+} // namespace Discregrid
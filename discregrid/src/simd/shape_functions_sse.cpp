@@ -0,0 +1,46 @@
+// Compiled with SSE2 enabled. Do not include headers other than the intrinsics and the kernel.
+#include "shape_functions.hpp"
+#include "shape_function_kernel.hpp"
+
+#include <immintrin.h>
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        namespace
+        {
+
+            struct Vec
+            {
+                static constexpr unsigned int width = 4u;
+
+                Vec(__m128 v_) : v(v_) {}
+                Vec(float s) : v(_mm_set1_ps(s)) {}
+
+                static Vec load(float const *p) { return _mm_loadu_ps(p); }
+                static void store(float *p, Vec a) { _mm_storeu_ps(p, a.v); }
+
+                __m128 v;
+            };
+
+            inline Vec operator+(Vec a, Vec b) { return _mm_add_ps(a.v, b.v); }
+            inline Vec operator-(Vec a, Vec b) { return _mm_sub_ps(a.v, b.v); }
+            inline Vec operator*(Vec a, Vec b) { return _mm_mul_ps(a.v, b.v); }
+            inline Vec operator-(Vec a) { return _mm_sub_ps(_mm_setzero_ps(), a.v); }
+            inline Vec operator+(float a, Vec b) { return Vec(a) + b; }
+            inline Vec operator-(float a, Vec b) { return Vec(a) - b; }
+            inline Vec operator*(float a, Vec b) { return Vec(a) * b; }
+            inline Vec operator-(Vec a, float b) { return a - Vec(b); }
+
+        } // namespace
+
+        void
+        shapeFunctionsSSE(float const *xi, float const *yi, float const *zi, float *N, float *dN)
+        {
+            shapeFunctions<Vec>(xi, yi, zi, N, dN);
+        }
+
+    } // namespace simd
+} // namespace Discregrid
@@ -0,0 +1,92 @@
+#include "triangle_distance.hpp"
+#include "triangle_distance_kernel.hpp"
+#include "../utility/cpu_features.hpp"
+
+#include <algorithm>
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        namespace
+        {
+
+            // Single-lane fallback for targets without a vectorized kernel.
+            struct Scalar
+            {
+                static constexpr unsigned int width = 1u;
+
+                struct Mask
+                {
+                    bool m;
+                };
+
+                Scalar(float v_) : v(v_) {}
+
+                static Scalar load(float const *p) { return *p; }
+                static void store(float *p, Scalar a) { *p = a.v; }
+                static Scalar lanes() { return 0.0f; }
+                static Scalar select(Mask m, Scalar a, Scalar b) { return m.m ? a : b; }
+                static Scalar max(Scalar a, Scalar b) { return std::max(a.v, b.v); }
+
+                float v;
+            };
+
+            inline Scalar operator+(Scalar a, Scalar b) { return a.v + b.v; }
+            inline Scalar operator-(Scalar a, Scalar b) { return a.v - b.v; }
+            inline Scalar operator*(Scalar a, Scalar b) { return a.v * b.v; }
+            inline Scalar operator/(Scalar a, Scalar b) { return a.v / b.v; }
+            inline Scalar operator-(Scalar a) { return -a.v; }
+
+            inline Scalar::Mask operator<(Scalar a, Scalar b) { return {a.v < b.v}; }
+            inline Scalar::Mask operator<=(Scalar a, Scalar b) { return {a.v <= b.v}; }
+            inline Scalar::Mask operator>(Scalar a, Scalar b) { return {a.v > b.v}; }
+            inline Scalar::Mask operator>=(Scalar a, Scalar b) { return {a.v >= b.v}; }
+            inline Scalar::Mask operator&(Scalar::Mask a, Scalar::Mask b) { return {a.m && b.m}; }
+            inline Scalar::Mask operator|(Scalar::Mask a, Scalar::Mask b) { return {a.m || b.m}; }
+            inline Scalar::Mask operator!(Scalar::Mask a) { return {!a.m}; }
+
+            float
+            pointTriangleSqDistanceScalar(TriangleData const &triangles, unsigned int begin, unsigned int n,
+                                          float const *x, unsigned int *nearest, int *ne)
+            {
+                return pointTriangleSqDistance<Scalar>(triangles, begin, n, x, nearest, ne);
+            }
+
+            PointTriangleKernelInfo
+            selectKernel()
+            {
+                auto const scalar = PointTriangleKernelInfo{pointTriangleSqDistanceScalar, 1u, "scalar"};
+#if defined(DISCREGRID_SIMD_X86)
+                auto const sse = PointTriangleKernelInfo{pointTriangleSqDistanceSSE, 4u, "sse"};
+                auto const avx2 = PointTriangleKernelInfo{pointTriangleSqDistanceAVX2, 8u, "avx2"};
+
+                // The kernel is selected once for all meshes, whereas the leaf size is configured
+                // per MeshDistance. With the default of at most 9 triangles per leaf, 16 lanes would
+                // mostly be idle, so there is no AVX-512 kernel and AVX2 is also used on CPUs
+                // supporting AVX-512. Larger leaves are processed 8 triangles at a time.
+                switch (simdLevel(SimdLevel::AVX2))
+                {
+                case SimdLevel::AVX2:
+                    return avx2;
+                case SimdLevel::SSE:
+                    return sse;
+                default:
+                    break;
+                }
+#endif
+                return scalar;
+            }
+
+        } // namespace
+
+        PointTriangleKernelInfo const &
+        pointTriangleKernel()
+        {
+            static PointTriangleKernelInfo const kernel = selectKernel();
+            return kernel;
+        }
+
+    } // namespace simd
+} // namespace Discregrid
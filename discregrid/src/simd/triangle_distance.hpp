@@ -0,0 +1,54 @@
+#pragma once
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        // Structure-of-arrays description of a set of triangles with one entry per triangle in each
+        // array. Besides the first vertex v0 and the edges e0 = v1 - v0 and e1 = v2 - v0, the point
+        // independent terms of point_triangle_sqdistance are stored: a00 = e0.e0, a01 = e0.e1,
+        // a11 = e1.e1, det = |a00 a11 - a01^2| and denom = a00 - 2 a01 + a11. Every array is padded
+        // by max_triangle_kernel_width - 1 finite entries such that full vectors can be loaded.
+        struct TriangleData
+        {
+            float const *v0[3];
+            float const *e0[3];
+            float const *e1[3];
+            float const *a00;
+            float const *a01;
+            float const *a11;
+            float const *det;
+            float const *denom;
+        };
+
+        // Determines the squared distance of point x to the closest of the triangles
+        // [begin, begin + n). The index of that triangle is written to nearest and, if ne is not null,
+        // the closest feature as the integer value of NearestEntity to ne. Among equally distant
+        // triangles the first one is reported. Returns std::numeric_limits<float>::max() if n is zero.
+        using PointTriangleKernel = float (*)(TriangleData const &triangles, unsigned int begin, unsigned int n,
+                                              float const *x, unsigned int *nearest, int *ne);
+
+        struct PointTriangleKernelInfo
+        {
+            PointTriangleKernel evaluate;
+            unsigned int width;
+            char const *name;
+        };
+
+        // Largest number of triangles processed at once by any kernel.
+        unsigned int const max_triangle_kernel_width = 8u;
+
+        // Returns the widest kernel supported by the executing CPU. The choice can be restricted by
+        // setting the environment variable DISCREGRID_SIMD to scalar or sse.
+        PointTriangleKernelInfo const &pointTriangleKernel();
+
+#if defined(DISCREGRID_SIMD_X86)
+        float pointTriangleSqDistanceSSE(TriangleData const &triangles, unsigned int begin, unsigned int n,
+                                         float const *x, unsigned int *nearest, int *ne);
+        float pointTriangleSqDistanceAVX2(TriangleData const &triangles, unsigned int begin, unsigned int n,
+                                          float const *x, unsigned int *nearest, int *ne);
+#endif
+
+    } // namespace simd
+} // namespace Discregrid
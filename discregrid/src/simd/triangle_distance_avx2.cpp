@@ -0,0 +1,64 @@
+// Compiled with AVX2 enabled and without floating-point contraction. Do not include headers other than the intrinsics and the kernel.
+#include "triangle_distance.hpp"
+#include "triangle_distance_kernel.hpp"
+
+#include <immintrin.h>
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        namespace
+        {
+
+            struct Vec
+            {
+                static constexpr unsigned int width = 8u;
+
+                struct Mask
+                {
+                    __m256 m;
+                };
+
+                Vec(__m256 v_) : v(v_) {}
+                Vec(float s) : v(_mm256_set1_ps(s)) {}
+
+                static Vec load(float const *p) { return _mm256_loadu_ps(p); }
+                static void store(float *p, Vec a) { _mm256_storeu_ps(p, a.v); }
+                static Vec lanes() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+                static Vec select(Mask m, Vec a, Vec b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+                static Vec max(Vec a, Vec b) { return _mm256_max_ps(a.v, b.v); }
+
+                __m256 v;
+            };
+
+            inline Vec operator+(Vec a, Vec b) { return _mm256_add_ps(a.v, b.v); }
+            inline Vec operator-(Vec a, Vec b) { return _mm256_sub_ps(a.v, b.v); }
+            inline Vec operator*(Vec a, Vec b) { return _mm256_mul_ps(a.v, b.v); }
+            inline Vec operator/(Vec a, Vec b) { return _mm256_div_ps(a.v, b.v); }
+            inline Vec operator-(Vec a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+            inline Vec operator+(float a, Vec b) { return Vec(a) + b; }
+            inline Vec operator-(float a, Vec b) { return Vec(a) - b; }
+            inline Vec operator*(float a, Vec b) { return Vec(a) * b; }
+            inline Vec operator/(float a, Vec b) { return Vec(a) / b; }
+
+            inline Vec::Mask operator<(Vec a, Vec b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+            inline Vec::Mask operator<=(Vec a, Vec b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+            inline Vec::Mask operator>(Vec a, Vec b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+            inline Vec::Mask operator>=(Vec a, Vec b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+            inline Vec::Mask operator&(Vec::Mask a, Vec::Mask b) { return {_mm256_and_ps(a.m, b.m)}; }
+            inline Vec::Mask operator|(Vec::Mask a, Vec::Mask b) { return {_mm256_or_ps(a.m, b.m)}; }
+            inline Vec::Mask operator!(Vec::Mask a) { return {_mm256_xor_ps(a.m, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))}; }
+
+        } // namespace
+
+        float
+        pointTriangleSqDistanceAVX2(TriangleData const &triangles, unsigned int begin, unsigned int n,
+                                    float const *x, unsigned int *nearest, int *ne)
+        {
+            return pointTriangleSqDistance<Vec>(triangles, begin, n, x, nearest, ne);
+        }
+
+    } // namespace simd
+} // namespace Discregrid
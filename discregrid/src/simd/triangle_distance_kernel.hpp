@@ -0,0 +1,165 @@
+#pragma once
+
+// Generic, lane-parallel squared distance between a point and a set of triangles. Each lane
+// processes one triangle following point_triangle_sqdistance, but instead of branching into one
+// of the seven regions of the triangle plane, the candidates of all regions are computed and the
+// applicable one is chosen by lane masks. The kernel is instantiated per instruction set in the
+// triangle_distance_*.cpp translation units, which are compiled with the respective target flags.
+// This header must therefore not include any other header whose inline functions could be
+// emitted with those flags.
+//
+// Required interface of V:
+//   static constexpr unsigned int width;   number of lanes
+//   V(float);                              broadcast
+//   static V load(float const *);          unaligned load of width floats
+//   static void store(float *, V);         unaligned store of width floats
+//   static V lanes();                      0, 1, ..., width - 1
+//   static V select(Mask, V a, V b);       a in the lanes whose mask is set, b elsewhere
+//   static V max(V, V);
+//   +, -, *, / between V and V or float, unary -
+//   <, <=, >, >= between V and V yielding V::Mask, which supports &, | and !
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        namespace detail
+        {
+
+            // Squared distance and closest feature, see NearestEntity, of a region candidate.
+            template <typename V>
+            struct Candidate
+            {
+                V d2, ne;
+            };
+
+            template <typename V>
+            inline Candidate<V>
+            pick(typename V::Mask m, Candidate<V> const &a, Candidate<V> const &b)
+            {
+                return {V::select(m, a.d2, b.d2), V::select(m, a.ne, b.ne)};
+            }
+
+        } // namespace detail
+
+        template <typename V>
+        inline float
+        pointTriangleSqDistance(TriangleData const &tri, unsigned int begin, unsigned int n,
+                                float const *x, unsigned int *nearest, int *ne)
+        {
+            using C = detail::Candidate<V>;
+            using detail::pick;
+
+            float const no_distance = 3.402823466e+38f;
+
+            V const px(x[0]), py(x[1]), pz(x[2]);
+            V const zero(0.0f);
+            V best = V(no_distance), best_index = zero, best_ne = zero;
+
+            for (unsigned int k = 0u; k < n; k += V::width)
+            {
+                auto i = begin + k;
+
+                V const dx = V::load(tri.v0[0] + i) - px;
+                V const dy = V::load(tri.v0[1] + i) - py;
+                V const dz = V::load(tri.v0[2] + i) - pz;
+                V const e0x = V::load(tri.e0[0] + i);
+                V const e0y = V::load(tri.e0[1] + i);
+                V const e0z = V::load(tri.e0[2] + i);
+                V const e1x = V::load(tri.e1[0] + i);
+                V const e1y = V::load(tri.e1[1] + i);
+                V const e1z = V::load(tri.e1[2] + i);
+                V const a00 = V::load(tri.a00 + i);
+                V const a01 = V::load(tri.a01 + i);
+                V const a11 = V::load(tri.a11 + i);
+                V const det = V::load(tri.det + i);
+                V const denom = V::load(tri.denom + i);
+
+                // Summed in the order of Eigen's unrolled dot product such that the results match
+                // those of point_triangle_sqdistance.
+                V const b0 = dx * e0x + (dy * e0y + dz * e0z);
+                V const b1 = dx * e1x + (dy * e1y + dz * e1z);
+                V const c = dx * dx + (dy * dy + dz * dz);
+                V const s = a01 * b1 - a11 * b0;
+                V const t = a01 * b0 - a00 * b1;
+
+                // Squared distance at the parameters (s, t) of the triangle plane.
+                auto quadric = [&](V const &s_, V const &t_)
+                {
+                    return s_ * (a00 * s_ + a01 * t_ + 2.0f * b0) +
+                           t_ * (a01 * s_ + a11 * t_ + 2.0f * b1) + c;
+                };
+
+                // Candidates of the vertices, edges and the face.
+                C const vn0 = {c, V(0.0f)};
+                C const vn1 = {a00 + 2.0f * b0 + c, V(1.0f)};
+                C const vn2 = {a11 + 2.0f * b1 + c, V(2.0f)};
+                V const s_en0 = -b0 / a00;
+                C const en0 = {b0 * s_en0 + c, V(3.0f)};
+                V const t_en2 = -b1 / a11;
+                C const en2 = {b1 * t_en2 + c, V(5.0f)};
+                V const inv_det = 1.0f / det;
+                C const fn = {quadric(s * inv_det, t * inv_det), V(6.0f)};
+
+                auto const s_neg = s < zero;
+                auto const t_neg = t < zero;
+                auto const inside = s + t <= det;
+
+                // Edge v1 v2 is parameterized by s in regions 1 and 2 and by t in region 6.
+                V const tmp0_2 = a01 + b0, tmp1_2 = a11 + b1;
+                V const tmp0_6 = a01 + b1, tmp1_6 = a00 + b0;
+                V const numer_1 = a11 + b1 - a01 - b0;
+                auto const region_6 = (!s_neg) & t_neg;
+                V const numer = V::select(s_neg, tmp1_2 - tmp0_2, V::select(t_neg, tmp1_6 - tmp0_6, numer_1));
+                V const q = numer / denom;
+                V const s_en1 = V::select(region_6, 1.0f - q, q);
+                V const t_en1 = V::select(region_6, q, 1.0f - q);
+                C const en1 = {quadric(s_en1, t_en1), V(4.0f)};
+
+                // Regions 0, 3, 4 and 5 with s + t <= det.
+                C const edge0 = pick(b0 >= zero, vn0, pick(-b0 >= a00, vn1, en0));
+                C const edge2 = pick(b1 >= zero, vn0, pick(-b1 >= a11, vn2, en2));
+                C const r_in = pick(s_neg, pick(t_neg & (b0 < zero), edge0, edge2), pick(t_neg, edge0, fn));
+
+                // Regions 1, 2 and 6 with s + t > det.
+                C const r_2 = pick(tmp1_2 > tmp0_2, pick(numer >= denom, vn1, en1),
+                                   pick(tmp1_2 <= zero, vn2, pick(b1 >= zero, vn0, en2)));
+                C const r_6 = pick(tmp1_6 > tmp0_6, pick(numer >= denom, vn2, en1),
+                                   pick(tmp1_6 <= zero, vn1, pick(b0 >= zero, vn0, en0)));
+                C const r_1 = pick(numer_1 <= zero, vn2, pick(numer_1 >= denom, vn1, en1));
+                C const r_out = pick(s_neg, r_2, pick(t_neg, r_6, r_1));
+
+                C const r = pick(inside, r_in, r_out);
+
+                // Account for numerical round-off error and discard the lanes beyond n.
+                V const lane = V::lanes() + static_cast<float>(k);
+                V const d2 = V::select(lane < V(static_cast<float>(n)), V::max(r.d2, zero), V(no_distance));
+
+                auto const closer = d2 < best;
+                best = V::select(closer, d2, best);
+                best_index = V::select(closer, lane, best_index);
+                best_ne = V::select(closer, r.ne, best_ne);
+            }
+
+            float d2[V::width], index[V::width], entity[V::width];
+            V::store(d2, best);
+            V::store(index, best_index);
+            V::store(entity, best_ne);
+
+            auto l_min = 0u;
+            for (auto l = 1u; l < V::width; ++l)
+                if (d2[l] < d2[l_min] || (d2[l] == d2[l_min] && index[l] < index[l_min]))
+                    l_min = l;
+
+            if (d2[l_min] < no_distance)
+            {
+                *nearest = begin + static_cast<unsigned int>(index[l_min]);
+                if (ne)
+                    *ne = static_cast<int>(entity[l_min]);
+            }
+            return d2[l_min];
+        }
+
+    } // namespace simd
+} // namespace Discregrid
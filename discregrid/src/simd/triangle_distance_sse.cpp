@@ -0,0 +1,64 @@
+// Compiled with SSE2 enabled. Do not include headers other than the intrinsics and the kernel.
+#include "triangle_distance.hpp"
+#include "triangle_distance_kernel.hpp"
+
+#include <immintrin.h>
+
+namespace Discregrid
+{
+    namespace simd
+    {
+
+        namespace
+        {
+
+            struct Vec
+            {
+                static constexpr unsigned int width = 4u;
+
+                struct Mask
+                {
+                    __m128 m;
+                };
+
+                Vec(__m128 v_) : v(v_) {}
+                Vec(float s) : v(_mm_set1_ps(s)) {}
+
+                static Vec load(float const *p) { return _mm_loadu_ps(p); }
+                static void store(float *p, Vec a) { _mm_storeu_ps(p, a.v); }
+                static Vec lanes() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+                static Vec select(Mask m, Vec a, Vec b) { return _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)); }
+                static Vec max(Vec a, Vec b) { return _mm_max_ps(a.v, b.v); }
+
+                __m128 v;
+            };
+
+            inline Vec operator+(Vec a, Vec b) { return _mm_add_ps(a.v, b.v); }
+            inline Vec operator-(Vec a, Vec b) { return _mm_sub_ps(a.v, b.v); }
+            inline Vec operator*(Vec a, Vec b) { return _mm_mul_ps(a.v, b.v); }
+            inline Vec operator/(Vec a, Vec b) { return _mm_div_ps(a.v, b.v); }
+            inline Vec operator-(Vec a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+            inline Vec operator+(float a, Vec b) { return Vec(a) + b; }
+            inline Vec operator-(float a, Vec b) { return Vec(a) - b; }
+            inline Vec operator*(float a, Vec b) { return Vec(a) * b; }
+            inline Vec operator/(float a, Vec b) { return Vec(a) / b; }
+
+            inline Vec::Mask operator<(Vec a, Vec b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+            inline Vec::Mask operator<=(Vec a, Vec b) { return {_mm_cmple_ps(a.v, b.v)}; }
+            inline Vec::Mask operator>(Vec a, Vec b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+            inline Vec::Mask operator>=(Vec a, Vec b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+            inline Vec::Mask operator&(Vec::Mask a, Vec::Mask b) { return {_mm_and_ps(a.m, b.m)}; }
+            inline Vec::Mask operator|(Vec::Mask a, Vec::Mask b) { return {_mm_or_ps(a.m, b.m)}; }
+            inline Vec::Mask operator!(Vec::Mask a) { return {_mm_xor_ps(a.m, _mm_castsi128_ps(_mm_set1_epi32(-1)))}; }
+
+        } // namespace
+
+        float
+        pointTriangleSqDistanceSSE(TriangleData const &triangles, unsigned int begin, unsigned int n,
+                                   float const *x, unsigned int *nearest, int *ne)
+        {
+            return pointTriangleSqDistance<Vec>(triangles, begin, n, x, nearest, ne);
+        }
+
+    } // namespace simd
+} // namespace Discregrid
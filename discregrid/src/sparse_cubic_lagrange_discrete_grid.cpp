@@ -0,0 +1,619 @@
+#include "sparse_cubic_lagrange_discrete_grid.hpp"
+#include "cubic_lagrange_shape_functions.hpp"
+#include "data/morton.hpp"
+#include "data/radix_sort.hpp"
+#include "utility/progress.hpp"
+#include <utility/serialize.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <omp.h>
+
+using namespace Eigen;
+
+namespace Discregrid
+{
+
+    namespace
+    {
+
+        // A brick covers brick_size^3 cells and stores the nodes of its (brick_size + 1)^3 vertex
+        // lattice. Every vertex owns 7 consecutive entries, its own node followed by the two inner nodes
+        // of its edges in positive x-, y- and z-direction. The vertices are stored lexicographically.
+        unsigned int const brick_size = 8u;
+        unsigned int const brick_cells = brick_size * brick_size * brick_size;
+        unsigned int const lattice_size = brick_size + 1u;
+        unsigned int const vertex_slots = 7u;
+        unsigned int const brick_nodes = vertex_slots * lattice_size * lattice_size * lattice_size;
+        unsigned int const brick_validity_words = brick_cells / 32u;
+
+        std::uint64_t const empty_key = ~std::uint64_t{0u};
+        unsigned int const no_brick = std::numeric_limits<unsigned int>::max();
+
+        inline std::uint64_t
+        brickKey(unsigned int i, unsigned int j, unsigned int k)
+        {
+            return std::uint64_t{i} | std::uint64_t{j} << 21 | std::uint64_t{k} << 42;
+        }
+
+        inline std::array<unsigned int, 3>
+        brickCoordinates(std::uint64_t key)
+        {
+            auto const mask = (std::uint64_t{1u} << 21) - 1u;
+            return {{static_cast<unsigned int>(key & mask),
+                     static_cast<unsigned int>(key >> 21 & mask),
+                     static_cast<unsigned int>(key >> 42 & mask)}};
+        }
+
+        inline unsigned int
+        vertexIndex(unsigned int a, unsigned int b, unsigned int c)
+        {
+            return vertex_slots * ((lattice_size * c + b) * lattice_size + a);
+        }
+
+        // Offsets of the 32 nodes of a cell relative to the first entry of its lower vertex, in the
+        // node order of the shape functions.
+        std::array<unsigned int, 32>
+        makeCellOffsets()
+        {
+            auto cell = std::array<unsigned int, 32>{};
+            cell[0] = vertexIndex(0, 0, 0);
+            cell[1] = vertexIndex(1, 0, 0);
+            cell[2] = vertexIndex(0, 1, 0);
+            cell[3] = vertexIndex(1, 1, 0);
+            cell[4] = vertexIndex(0, 0, 1);
+            cell[5] = vertexIndex(1, 0, 1);
+            cell[6] = vertexIndex(0, 1, 1);
+            cell[7] = vertexIndex(1, 1, 1);
+
+            cell[8] = cell[0] + 1;
+            cell[10] = cell[4] + 1;
+            cell[12] = cell[2] + 1;
+            cell[14] = cell[6] + 1;
+
+            cell[16] = cell[0] + 3;
+            cell[18] = cell[1] + 3;
+            cell[20] = cell[4] + 3;
+            cell[22] = cell[5] + 3;
+
+            cell[24] = cell[0] + 5;
+            cell[26] = cell[2] + 5;
+            cell[28] = cell[1] + 5;
+            cell[30] = cell[3] + 5;
+
+            for (auto e = 8u; e < 32u; e += 2u)
+                cell[e + 1] = cell[e] + 1;
+            return cell;
+        }
+
+        std::array<unsigned int, 32> const cell_offsets = makeCellOffsets();
+
+        // Nodes on the upper faces of a brick also lie on the lower faces of the bricks above, which
+        // own them if they exist in the grid of nb bricks. Returns true if node l of brick key is owned
+        // by another brick, yielding its key and the index of the node there.
+        inline bool
+        sharedNode(std::uint64_t key, unsigned int l, std::array<unsigned int, 3> const &nb,
+                   std::uint64_t &owner_key, unsigned int &owner_l)
+        {
+            auto v = l / vertex_slots;
+            unsigned int local[3] = {v % lattice_size, v / lattice_size % lattice_size, v / (lattice_size * lattice_size)};
+            auto b = brickCoordinates(key);
+            auto shared = false;
+            for (auto d = 0u; d < 3u; ++d)
+            {
+                if (local[d] == brick_size && b[d] + 1u < nb[d])
+                {
+                    local[d] = 0u;
+                    ++b[d];
+                    shared = true;
+                }
+            }
+            owner_key = brickKey(b[0], b[1], b[2]);
+            owner_l = vertexIndex(local[0], local[1], local[2]) + l % vertex_slots;
+            return shared;
+        }
+
+        // Index of the first coefficient of the lower vertex of cell c of brick b.
+        inline unsigned int
+        cellBase(unsigned int b, unsigned int c)
+        {
+            return b * brick_nodes + vertexIndex(c % brick_size, c / brick_size % brick_size, c / (brick_size * brick_size));
+        }
+
+        char const sparse_magic[8] = {'D', 'S', 'C', 'R', 'S', 'P', 'R', 'S'};
+        std::uint32_t const sparse_version = 1u;
+    } // namespace
+
+    SparseCubicLagrangeDiscreteGrid::SparseCubicLagrangeDiscreteGrid(std::string const &filename)
+    {
+        load(filename);
+    }
+
+    SparseCubicLagrangeDiscreteGrid::SparseCubicLagrangeDiscreteGrid(AlignedBox3f const &domain,
+                                                                     std::array<unsigned int, 3> const &resolution)
+        : DiscreteGrid(domain, resolution)
+    {
+    }
+
+    void SparseCubicLagrangeDiscreteGrid::save(std::string const &filename) const
+    {
+        auto out = std::ofstream(filename, std::ios::binary);
+        out.write(sparse_magic, sizeof(sparse_magic));
+        serialize::write(*out.rdbuf(), sparse_version);
+        serialize::write(*out.rdbuf(), m_domain);
+        serialize::write(*out.rdbuf(), m_resolution);
+        serialize::write(*out.rdbuf(), m_cell_size);
+        serialize::write(*out.rdbuf(), m_inv_cell_size);
+        serialize::write(*out.rdbuf(), m_n_cells);
+        serialize::write(*out.rdbuf(), m_n_fields);
+
+        for (auto const &field : m_fields)
+        {
+            serialize::write(*out.rdbuf(), field.bricks.size());
+            serialize::writeArray(*out.rdbuf(), field.bricks.data(), field.bricks.size());
+            serialize::writeArray(*out.rdbuf(), field.nodes.data(), field.nodes.size());
+            serialize::writeArray(*out.rdbuf(), field.cell_valid.data(), field.cell_valid.size());
+        }
+
+        out.close();
+    }
+
+    void SparseCubicLagrangeDiscreteGrid::load(std::string const &filename)
+    {
+        auto in = std::ifstream(filename, std::ios::binary);
+
+        if (!in.good())
+        {
+            std::cerr << "ERROR: Discrete grid can not be loaded. Input file does not exist!" << std::endl;
+            return;
+        }
+
+        char magic[sizeof(sparse_magic)] = {};
+        auto version = std::uint32_t{};
+        in.read(magic, sizeof(magic));
+        serialize::read(*in.rdbuf(), version);
+        if (std::memcmp(magic, sparse_magic, sizeof(magic)) != 0 || version != sparse_version)
+        {
+            std::cerr << "ERROR: Discrete grid can not be loaded. Input file is not a sparse grid of a supported version!" << std::endl;
+            return;
+        }
+
+        serialize::read(*in.rdbuf(), m_domain);
+        serialize::read(*in.rdbuf(), m_resolution);
+        serialize::read(*in.rdbuf(), m_cell_size);
+        serialize::read(*in.rdbuf(), m_inv_cell_size);
+        serialize::read(*in.rdbuf(), m_n_cells);
+        serialize::read(*in.rdbuf(), m_n_fields);
+
+        m_fields.assign(m_n_fields, {});
+        for (auto &field : m_fields)
+        {
+            auto n_bricks = std::size_t{};
+            serialize::read(*in.rdbuf(), n_bricks);
+            field.bricks.resize(n_bricks);
+            field.nodes.resize(n_bricks * brick_nodes);
+            field.cell_valid.resize(n_bricks * brick_validity_words);
+            serialize::readArray(*in.rdbuf(), field.bricks.data(), field.bricks.size());
+            serialize::readArray(*in.rdbuf(), field.nodes.data(), field.nodes.size());
+            serialize::readArray(*in.rdbuf(), field.cell_valid.data(), field.cell_valid.size());
+            buildTable(field);
+        }
+
+        in.close();
+    }
+
+    unsigned int
+    SparseCubicLagrangeDiscreteGrid::findBrick(Field const &field, std::uint64_t key) const
+    {
+        if (field.table_keys.empty())
+            return no_brick;
+
+        auto mask = field.table_keys.size() - 1u;
+        for (auto h = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> field.table_shift);; h = (h + 1u) & mask)
+        {
+            auto k = field.table_keys[h];
+            if (k == key)
+                return field.table_bricks[h];
+            if (k == empty_key)
+                return no_brick;
+        }
+    }
+
+    void
+    SparseCubicLagrangeDiscreteGrid::buildTable(Field &field) const
+    {
+        // At most half of the slots are occupied.
+        auto bits = 1u;
+        while ((std::size_t{1u} << bits) < 2u * field.bricks.size())
+            ++bits;
+
+        field.table_shift = 64u - bits;
+        field.table_keys.assign(std::size_t{1u} << bits, empty_key);
+        field.table_bricks.assign(std::size_t{1u} << bits, no_brick);
+
+        auto mask = field.table_keys.size() - 1u;
+        for (auto b = 0u; b < field.bricks.size(); ++b)
+        {
+            auto key = field.bricks[b];
+            auto h = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> field.table_shift);
+            while (field.table_keys[h] != empty_key)
+                h = (h + 1u) & mask;
+            field.table_keys[h] = key;
+            field.table_bricks[h] = b;
+        }
+    }
+
+    bool
+    SparseCubicLagrangeDiscreteGrid::brickNodePosition(std::uint64_t brick, unsigned int l, Vector3f &x) const
+    {
+        auto slot = l % vertex_slots;
+        auto v = l / vertex_slots;
+        auto local = Matrix<unsigned int, 3, 1>{v % lattice_size, v / lattice_size % lattice_size, v / (lattice_size * lattice_size)};
+        auto b = brickCoordinates(brick);
+        auto ijk = Matrix<unsigned int, 3, 1>{};
+        for (auto d = 0u; d < 3u; ++d)
+            ijk[d] = brick_size * b[d] + local[d];
+
+        // Edges leaving the brick or the grid are not referenced by any cell of the brick.
+        for (auto d = 0u; d < 3u; ++d)
+        {
+            auto edge = slot > 0u && (slot - 1u) / 2u == d;
+            if (ijk[d] > m_resolution[d] || (edge && (ijk[d] == m_resolution[d] || local[d] == brick_size)))
+                return false;
+        }
+
+        x = m_domain.min() + m_cell_size.cwiseProduct(ijk.cast<float>());
+        if (slot > 0u)
+        {
+            auto d = (slot - 1u) / 2u;
+            x(d) += (1.0 + static_cast<float>((slot - 1u) % 2u)) / 3.0 * m_cell_size[d];
+        }
+        return true;
+    }
+
+    void
+    SparseCubicLagrangeDiscreteGrid::updateCellValidity(Field &field, unsigned int brick) const
+    {
+        auto b = brickCoordinates(field.bricks[brick]);
+        auto bits = &field.cell_valid[brick * brick_validity_words];
+        std::fill(bits, bits + brick_validity_words, 0u);
+
+        float c[32];
+        for (auto cell = 0u; cell < brick_cells; ++cell)
+        {
+            if (brick_size * b[0] + cell % brick_size >= m_resolution[0] ||
+                brick_size * b[1] + cell / brick_size % brick_size >= m_resolution[1] ||
+                brick_size * b[2] + cell / (brick_size * brick_size) >= m_resolution[2])
+                continue;
+
+            auto base = cellBase(brick, cell);
+            for (auto j = 0u; j < 32u; ++j)
+                c[j] = field.nodes[base + cell_offsets[j]];
+            if (defined(c))
+                bits[cell >> 5] |= 1u << (cell & 31u);
+        }
+    }
+
+    unsigned int
+    SparseCubicLagrangeDiscreteGrid::addFunction(ContinuousFunction const &func, bool verbose,
+                                                 SamplePredicate const &pred)
+    {
+        return addFunction(BatchFunction([&func](std::size_t n, float const *xs, float const *ys, float const *zs, float *values)
+                                         {
+                                             for (auto i = std::size_t{0u}; i < n; ++i)
+                                                 values[i] = func(Vector3f(xs[i], ys[i], zs[i]));
+                                         }),
+                           verbose, pred);
+    }
+
+    unsigned int
+    SparseCubicLagrangeDiscreteGrid::addFunction(BatchFunction const &func, bool verbose,
+                                                 SamplePredicate const &pred)
+    {
+        using namespace std::chrono;
+
+        auto t0_construction = high_resolution_clock::now();
+
+        auto nb = std::array<unsigned int, 3>{};
+        for (auto d = 0u; d < 3u; ++d)
+            nb[d] = (m_resolution[d] + brick_size - 1u) / brick_size;
+        auto n_candidates = static_cast<long long>(nb[0]) * nb[1] * nb[2];
+
+        // Each thread samples whole bricks and keeps those with at least one sampled node. func is
+        // only evaluated at the nodes owned by a brick; the shared nodes are copied from their owners
+        // once all bricks are known, such that every node is evaluated once.
+        auto n_threads = omp_get_max_threads();
+        auto thread_bricks = std::vector<std::vector<std::uint64_t>>(n_threads);
+        auto thread_nodes = std::vector<std::vector<float>>(n_threads);
+        ProgressReporter progress(static_cast<std::size_t>(n_candidates), verbose, m_progress_callback);
+
+#pragma omp parallel default(shared)
+        {
+            auto &bricks = thread_bricks[omp_get_thread_num()];
+            auto &nodes = thread_nodes[omp_get_thread_num()];
+            auto sampled = std::vector<float>(brick_nodes);
+            auto xs = std::vector<float>{}, ys = std::vector<float>{}, zs = std::vector<float>{};
+            auto values = std::vector<float>{};
+            auto indices = std::vector<unsigned int>{};
+
+#pragma omp for schedule(dynamic, 16) nowait
+            for (long long candidate = 0; candidate < n_candidates; ++candidate)
+            {
+                auto key = brickKey(static_cast<unsigned int>(candidate % nb[0]),
+                                    static_cast<unsigned int>(candidate / nb[0] % nb[1]),
+                                    static_cast<unsigned int>(candidate / nb[0] / nb[1]));
+
+                xs.clear();
+                ys.clear();
+                zs.clear();
+                indices.clear();
+                auto any_shared = false;
+                for (auto l = 0u; l < brick_nodes; ++l)
+                {
+                    auto x = Vector3f{};
+                    auto owner_key = std::uint64_t{};
+                    auto owner_l = 0u;
+                    sampled[l] = std::numeric_limits<float>::max();
+                    if (!brickNodePosition(key, l, x) || (pred && !pred(x)))
+                        continue;
+                    if (sharedNode(key, l, nb, owner_key, owner_l))
+                    {
+                        any_shared = true;
+                        continue;
+                    }
+                    xs.push_back(x[0]);
+                    ys.push_back(x[1]);
+                    zs.push_back(x[2]);
+                    indices.push_back(l);
+                }
+
+                if (!indices.empty() || any_shared)
+                {
+                    values.resize(indices.size());
+                    func(indices.size(), xs.data(), ys.data(), zs.data(), values.data());
+                    for (auto i = 0u; i < indices.size(); ++i)
+                        sampled[indices[i]] = values[i];
+
+                    bricks.push_back(key);
+                    nodes.insert(nodes.end(), sampled.begin(), sampled.end());
+                }
+
+                progress.add(1u);
+            }
+        }
+        progress.finish();
+
+        // The active bricks are stored along a z-curve.
+        auto keys = std::vector<std::uint64_t>{};
+        auto sources = std::vector<float const *>{};
+        for (auto t = 0; t < n_threads; ++t)
+        {
+            for (auto i = 0u; i < thread_bricks[t].size(); ++i)
+            {
+                keys.push_back(thread_bricks[t][i]);
+                sources.push_back(thread_nodes[t].data() + std::size_t{brick_nodes} * i);
+            }
+        }
+
+        auto n_bricks = keys.size();
+        auto order = std::vector<unsigned int>(n_bricks);
+        auto codes = std::vector<std::uint64_t>(n_bricks);
+        auto encode = mortonEncoder();
+        for (auto i = 0u; i < n_bricks; ++i)
+        {
+            codes[i] = encode(brickCoordinates(keys[i]));
+            order[i] = i;
+        }
+        radixSort(codes, order);
+
+        m_fields.push_back({});
+        auto &field = m_fields.back();
+        field.bricks.resize(n_bricks);
+        field.nodes.resize(n_bricks * brick_nodes);
+        field.cell_valid.resize(n_bricks * brick_validity_words);
+
+#pragma omp parallel for schedule(static)
+        for (int b = 0; b < static_cast<int>(n_bricks); ++b)
+        {
+            field.bricks[b] = keys[order[b]];
+            std::copy(sources[order[b]], sources[order[b]] + brick_nodes, field.nodes.begin() + std::size_t{brick_nodes} * b);
+        }
+
+        buildTable(field);
+
+        // Only the shared nodes are written, which are read from the owned nodes of other bricks.
+#pragma omp parallel for schedule(static)
+        for (int b = 0; b < static_cast<int>(n_bricks); ++b)
+        {
+            auto nodes = field.nodes.data() + std::size_t{brick_nodes} * b;
+            for (auto l = 0u; l < brick_nodes; ++l)
+            {
+                auto x = Vector3f{};
+                auto owner_key = std::uint64_t{};
+                auto owner_l = 0u;
+                if (!brickNodePosition(field.bricks[b], l, x) || !sharedNode(field.bricks[b], l, nb, owner_key, owner_l))
+                    continue;
+                auto owner = findBrick(field, owner_key);
+                if (owner != no_brick)
+                    nodes[l] = field.nodes[std::size_t{brick_nodes} * owner + owner_l];
+            }
+            updateCellValidity(field, b);
+        }
+
+        if (verbose)
+        {
+            std::cout << "\rConstruction took " << std::setw(15) << static_cast<float>(duration_cast<milliseconds>(high_resolution_clock::now() - t0_construction).count()) / 1000.0 << "s" << std::endl;
+        }
+
+        return static_cast<unsigned int>(m_n_fields++);
+    }
+
+    bool
+    SparseCubicLagrangeDiscreteGrid::locateCell(Field const &field, Vector3f const &x, unsigned int &brick,
+                                                unsigned int &cell, Vector3f &xi, Vector3f &c0) const
+    {
+        if (!m_domain.contains(x))
+            return false;
+
+        auto mi = (x - m_domain.min()).cwiseProduct(m_inv_cell_size).cast<unsigned int>().eval();
+        for (auto d = 0u; d < 3u; ++d)
+        {
+            if (mi[d] >= m_resolution[d])
+                mi[d] = m_resolution[d] - 1;
+        }
+
+        brick = findBrick(field, brickKey(mi[0] / brick_size, mi[1] / brick_size, mi[2] / brick_size));
+        if (brick == no_brick)
+            return false;
+        cell = ((mi[2] % brick_size) * brick_size + mi[1] % brick_size) * brick_size + mi[0] % brick_size;
+
+        auto sd = subdomain(MultiIndex{{mi[0], mi[1], mi[2]}});
+        auto denom = (sd.max() - sd.min()).eval();
+        c0 = Vector3f::Constant(2.0).cwiseQuotient(denom).eval();
+        auto c1 = (sd.max() + sd.min()).cwiseQuotient(denom).eval();
+        xi = (c0.cwiseProduct(x) - c1).eval();
+        return true;
+    }
+
+    float
+    SparseCubicLagrangeDiscreteGrid::interpolate(unsigned int field_id, Vector3f const &x,
+                                                 Vector3f *gradient) const
+    {
+        auto const &field = m_fields[field_id];
+        auto brick = 0u, cell = 0u;
+        auto xi = Vector3f{};
+        auto c0 = Vector3f{};
+        if (!locateCell(field, x, brick, cell, xi, c0))
+            return std::numeric_limits<float>::max();
+
+        if (!testBit(&field.cell_valid[brick * brick_validity_words], cell))
+        {
+            if (gradient)
+                gradient->setZero();
+            return std::numeric_limits<float>::max();
+        }
+
+        float c[32];
+        auto nodes = field.nodes.data() + cellBase(brick, cell);
+        for (auto j = 0u; j < 32u; ++j)
+            c[j] = nodes[cell_offsets[j]];
+
+        if (!gradient)
+        {
+            auto N = cubicLagrangeShapeFunctions(xi, nullptr);
+            return contract(c, N, nullptr, c0, nullptr);
+        }
+
+        auto dN = Matrix<float, 32, 3>{};
+        auto N = cubicLagrangeShapeFunctions(xi, &dN);
+        return contract(c, N, &dN, c0, gradient);
+    }
+
+    bool
+    SparseCubicLagrangeDiscreteGrid::determineShapeFunctions(unsigned int field_id, Vector3f const &x,
+                                                             std::array<unsigned int, 32> &cell, Vector3f &c0, Matrix<float, 32, 1> &N,
+                                                             Matrix<float, 32, 3> *dN) const
+    {
+        auto const &field = m_fields[field_id];
+        auto brick = 0u, local = 0u;
+        auto xi = Vector3f{};
+        // Cells discarded by reduceField are rejected like by interpolate, even if their brick is kept.
+        if (!locateCell(field, x, brick, local, xi, c0) ||
+            !testBit(&field.cell_valid[brick * brick_validity_words], local))
+            return false;
+
+        auto base = cellBase(brick, local);
+        for (auto j = 0u; j < 32u; ++j)
+            cell[j] = base + cell_offsets[j];
+        N = cubicLagrangeShapeFunctions(xi, dN);
+        return true;
+    }
+
+    float
+    SparseCubicLagrangeDiscreteGrid::interpolate(unsigned int field_id, Vector3f const &, const std::array<unsigned int, 32> &cell, const Vector3f &c0, const Matrix<float, 32, 1> &N,
+                                                 Vector3f *gradient, Matrix<float, 32, 3> *dN) const
+    {
+        auto const &nodes = m_fields[field_id].nodes;
+        float c[32];
+        for (auto j = 0u; j < 32u; ++j)
+            c[j] = nodes[cell[j]];
+        if (!defined(c))
+        {
+            if (gradient)
+                gradient->setZero();
+            return std::numeric_limits<float>::max();
+        }
+        return contract(c, N, dN, c0, gradient);
+    }
+
+    void SparseCubicLagrangeDiscreteGrid::reduceField(unsigned int field_id, Predicate pred)
+    {
+        auto &field = m_fields[field_id];
+        auto n_bricks = static_cast<int>(field.bricks.size());
+
+        // Cells none of whose nodes fulfills the predicate are marked invalid.
+        auto keep = std::vector<unsigned char>(n_bricks);
+#pragma omp parallel for schedule(dynamic, 16)
+        for (int b = 0; b < n_bricks; ++b)
+        {
+            auto flag = std::vector<unsigned char>(brick_nodes);
+            auto nodes = &field.nodes[std::size_t{brick_nodes} * b];
+            for (auto l = 0u; l < brick_nodes; ++l)
+            {
+                auto x = Vector3f{};
+                flag[l] = nodes[l] != std::numeric_limits<float>::max() &&
+                          brickNodePosition(field.bricks[b], l, x) && pred(x, nodes[l]);
+            }
+
+            auto bits = &field.cell_valid[b * brick_validity_words];
+            for (auto cell = 0u; cell < brick_cells; ++cell)
+            {
+                if (!testBit(bits, cell))
+                    continue;
+                auto base = vertexIndex(cell % brick_size, cell / brick_size % brick_size, cell / (brick_size * brick_size));
+                auto kept = 0u;
+                for (auto j = 0u; j < 32u; ++j)
+                    kept |= flag[base + cell_offsets[j]];
+                if (!kept)
+                    bits[cell >> 5] &= ~(1u << (cell & 31u));
+            }
+
+            keep[b] = std::any_of(bits, bits + brick_validity_words, [](std::uint32_t w)
+                                  { return w != 0u; });
+        }
+
+        // Bricks without valid cells are released, the others keep their order.
+        auto n_kept = 0u;
+        for (auto b = 0; b < n_bricks; ++b)
+        {
+            if (!keep[b])
+                continue;
+            if (n_kept != static_cast<unsigned int>(b))
+            {
+                field.bricks[n_kept] = field.bricks[b];
+                std::copy(field.nodes.begin() + std::size_t{brick_nodes} * b, field.nodes.begin() + std::size_t{brick_nodes} * (b + 1),
+                          field.nodes.begin() + std::size_t{brick_nodes} * n_kept);
+                std::copy(field.cell_valid.begin() + brick_validity_words * b, field.cell_valid.begin() + brick_validity_words * (b + 1),
+                          field.cell_valid.begin() + brick_validity_words * n_kept);
+            }
+            ++n_kept;
+        }
+
+        field.bricks.resize(n_kept);
+        field.bricks.shrink_to_fit();
+        field.nodes.resize(std::size_t{brick_nodes} * n_kept);
+        field.nodes.shrink_to_fit();
+        field.cell_valid.resize(brick_validity_words * n_kept);
+        field.cell_valid.shrink_to_fit();
+        buildTable(field);
+    }
+
+    std::size_t
+    SparseCubicLagrangeDiscreteGrid::nBricks(unsigned int field_id) const
+    {
+        return m_fields[field_id].bricks.size();
+    }
+
+} // namespace Discregrid
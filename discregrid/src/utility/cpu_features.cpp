@@ -0,0 +1,123 @@
+#include "cpu_features.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+#if defined(DISCREGRID_SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace Discregrid
+{
+
+    namespace
+    {
+
+#if defined(DISCREGRID_SIMD_X86)
+        void
+        cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+        {
+#if defined(_MSC_VER)
+            int r[4];
+            __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (auto i = 0u; i < 4u; ++i)
+                regs[i] = static_cast<unsigned int>(r[i]);
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        // Returns the state components enabled by the operating system (XCR0).
+        unsigned long long
+        xgetbv0()
+        {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            unsigned int eax, edx;
+            __asm__ volatile("xgetbv"
+                             : "=a"(eax), "=d"(edx)
+                             : "c"(0));
+            return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+        }
+#endif
+
+        CpuFeatures
+        detect()
+        {
+            auto f = CpuFeatures{};
+#if defined(DISCREGRID_SIMD_X86)
+            unsigned int regs[4];
+            cpuid(0, 0, regs);
+            auto max_leaf = regs[0];
+            // The vendor string is stored in ebx, edx, ecx; its first four characters suffice.
+            auto amd = regs[1] == 0x68747541u || regs[1] == 0x6f677948u; // "Auth"enticAMD, "Hygo"nGenuine
+
+            cpuid(1, 0, regs);
+            auto family = (regs[0] >> 8) & 0xfu;
+            if (family == 0xfu)
+                family += (regs[0] >> 20) & 0xffu;
+            f.sse2 = (regs[3] & (1u << 26)) != 0;
+            auto osxsave = (regs[2] & (1u << 27)) != 0;
+            auto fma = (regs[2] & (1u << 12)) != 0;
+
+            // AVX requires the OS to save the ymm state (XCR0 bits 1, 2), AVX-512 additionally
+            // the opmask and zmm state (bits 5, 6, 7).
+            auto xcr0 = osxsave ? xgetbv0() : 0ull;
+            auto os_avx = (xcr0 & 0x06) == 0x06;
+            auto os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+            if (max_leaf >= 7)
+            {
+                cpuid(7, 0, regs);
+                f.avx2 = os_avx && (regs[1] & (1u << 5)) != 0;
+                f.bmi2 = (regs[1] & (1u << 8)) != 0;
+                f.fast_pdep = f.bmi2 && !(amd && family < 0x19u);
+                f.avx512f = os_avx512 && (regs[1] & (1u << 16)) != 0;
+            }
+            f.fma = os_avx && fma;
+#endif
+            return f;
+        }
+
+    } // namespace
+
+    CpuFeatures const &
+    cpuFeatures()
+    {
+        static CpuFeatures const features = detect();
+        return features;
+    }
+
+    SimdLevel
+    simdLevel(SimdLevel widest)
+    {
+        auto const &cpu = cpuFeatures();
+        auto level = SimdLevel::Scalar;
+        if (cpu.sse2)
+            level = SimdLevel::SSE;
+        if (cpu.avx2 && cpu.fma)
+            level = SimdLevel::AVX2;
+        if (cpu.avx512f && cpu.avx2 && cpu.fma)
+            level = SimdLevel::AVX512;
+
+        auto requested = std::string{};
+        if (auto env = std::getenv("DISCREGRID_SIMD"))
+            requested = env;
+        if (requested == "scalar")
+            widest = SimdLevel::Scalar;
+        else if (requested == "sse")
+            widest = std::min(widest, SimdLevel::SSE);
+        else if (requested == "avx2")
+            widest = std::min(widest, SimdLevel::AVX2);
+
+        return std::min(level, widest);
+    }
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+namespace Discregrid
+{
+
+    // Instruction set extensions supported by the executing CPU and enabled by the operating system.
+    struct CpuFeatures
+    {
+        bool sse2 = false;
+        bool avx2 = false;
+        bool fma = false;
+        bool avx512f = false;
+        bool bmi2 = false;
+        // BMI2 with pdep and pext executed in hardware. AMD CPUs before Zen 3 implement them in
+        // microcode, with a latency growing with the number of set mask bits.
+        bool fast_pdep = false;
+    };
+
+    // Queries the CPU once and returns the cached result. All flags are false on non-x86 targets.
+    CpuFeatures const &cpuFeatures();
+
+    // Instruction sets for which SIMD kernels exist, ordered by width.
+    enum class SimdLevel
+    {
+        Scalar,
+        // SSE2
+        SSE,
+        // AVX2 and FMA
+        AVX2,
+        // AVX-512F, AVX2 and FMA
+        AVX512
+    };
+
+    // Returns the widest level up to widest that the executing CPU supports. Narrower levels can be
+    // forced by setting the environment variable DISCREGRID_SIMD to scalar, sse, avx2 or avx512,
+    // e.g. for benchmarking.
+    SimdLevel simdLevel(SimdLevel widest);
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Discregrid
+{
+
+    // Read-only memory mapping of a whole file. Pages are loaded lazily by the operating system and
+    // shared between all processes mapping the same file.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(std::string const &filename);
+        ~MappedFile();
+
+        MappedFile(MappedFile const &) = delete;
+        MappedFile &operator=(MappedFile const &) = delete;
+
+        bool isOpen() const { return m_data != nullptr; }
+        char const *data() const { return m_data; }
+        std::size_t size() const { return m_size; }
+
+    private:
+        char const *m_data = nullptr;
+        std::size_t m_size = 0u;
+#ifdef _WIN32
+        void *m_file = nullptr;
+        void *m_mapping = nullptr;
+#endif
+    };
+
+}
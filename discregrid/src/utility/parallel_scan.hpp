@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace Discregrid
+{
+
+    // Replaces v by its exclusive prefix sum and returns the total. The sum is computed in parallel
+    // in two passes over contiguous blocks: block totals first, then the offsets within each block.
+    template <typename T>
+    T exclusiveScan(std::vector<T> &v)
+    {
+        auto const block_size = std::size_t{1u} << 16;
+        auto n = v.size();
+        auto n_blocks = static_cast<int>((n + block_size - 1) / block_size);
+        auto offsets = std::vector<T>(n_blocks + 1, T{0});
+
+#pragma omp parallel for schedule(static)
+        for (int b = 0; b < n_blocks; ++b)
+        {
+            auto end = std::min(n, (b + 1) * block_size);
+            auto sum = T{0};
+            for (auto i = b * block_size; i < end; ++i)
+                sum += v[i];
+            offsets[b + 1] = sum;
+        }
+
+        for (auto b = 0; b < n_blocks; ++b)
+            offsets[b + 1] += offsets[b];
+
+#pragma omp parallel for schedule(static)
+        for (int b = 0; b < n_blocks; ++b)
+        {
+            auto end = std::min(n, (b + 1) * block_size);
+            auto sum = offsets[b];
+            for (auto i = b * block_size; i < end; ++i)
+            {
+                auto x = v[i];
+                v[i] = sum;
+                sum += x;
+            }
+        }
+
+        return offsets[n_blocks];
+    }
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace Discregrid
+{
+    // Reports the progress of a parallel construction. The workers only increment an atomic counter.
+    // A reporter thread, which is only started if the progress is printed or a callback is given,
+    // periodically reads the counter, prints the percentage and invokes the callback.
+    class ProgressReporter
+    {
+    public:
+        using Callback = std::function<void(std::size_t, std::size_t)>;
+
+        ProgressReporter(std::size_t total, bool verbose, Callback const &callback,
+                         std::chrono::milliseconds interval = std::chrono::milliseconds(500))
+            : m_total(total), m_verbose(verbose), m_callback(callback), m_interval(interval)
+        {
+            if (m_verbose || m_callback)
+                m_thread = std::thread([this]()
+                                       { run(); });
+        }
+
+        ~ProgressReporter()
+        {
+            finish();
+        }
+
+        void add(std::size_t n)
+        {
+            m_done.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        // Stops the reporter thread after a final report.
+        void finish()
+        {
+            if (!m_thread.joinable())
+                return;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_finished = true;
+            }
+            m_cv.notify_one();
+            m_thread.join();
+        }
+
+    private:
+        void run()
+        {
+            auto finished = false;
+            while (!finished)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    finished = m_cv.wait_for(lock, m_interval, [this]()
+                                             { return m_finished; });
+                }
+                report();
+            }
+        }
+
+        void report() const
+        {
+            auto done = m_done.load(std::memory_order_relaxed);
+            if (m_verbose)
+            {
+                std::cout << "\r"
+                          << "Construction " << std::setw(20)
+                          << (m_total ? 100.0 * static_cast<double>(done) / static_cast<double>(m_total) : 100.0) << "%" << std::flush;
+            }
+            if (m_callback)
+                m_callback(done, m_total);
+        }
+
+        std::size_t m_total;
+        bool m_verbose;
+        Callback m_callback;
+        std::chrono::milliseconds m_interval;
+
+        std::atomic<std::size_t> m_done{0u};
+        bool m_finished = false;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::thread m_thread;
+    };
+}
@@ -0,0 +1,62 @@
+#include <Discregrid/All>
+#include <Eigen/Dense>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+using namespace Eigen;
+
+// Reducing a field twice must yield the same field as a single reduction by the second predicate
+// if it implies the first one.
+
+namespace
+{
+
+std::string fileContents(std::string const& filename)
+{
+	auto in = std::ifstream(filename, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+}
+
+int main()
+{
+	auto domain = AlignedBox3f(Vector3f::Constant(-1.0f), Vector3f::Constant(1.0f));
+	auto sphere = [](Vector3f const& x) { return x.norm() - 0.5f; };
+
+	auto wide = [](Vector3f const&, float v) { return std::abs(v) < 0.3f; };
+	auto narrow = [](Vector3f const& x, float v) { return std::abs(v) < 0.15f && x.x() < 0.2f; };
+
+	Discregrid::CubicLagrangeDiscreteGrid once(domain, {{16, 20, 24}});
+	once.addFunction(sphere);
+	once.reduceField(0u, narrow);
+
+	Discregrid::CubicLagrangeDiscreteGrid twice(domain, {{16, 20, 24}});
+	twice.addFunction(sphere);
+	twice.reduceField(0u, wide);
+	twice.reduceField(0u, narrow);
+
+	once.save("reduce_field_once.cdf");
+	twice.save("reduce_field_twice.cdf");
+	if (fileContents("reduce_field_once.cdf") != fileContents("reduce_field_twice.cdf"))
+	{
+		std::cerr << "ERROR: Reducing twice differs from a single reduction." << std::endl;
+		return 1;
+	}
+
+	for (auto i = 0u; i < 1000u; ++i)
+	{
+		auto x = Vector3f::Random().eval();
+		auto a = once.interpolate(0u, x);
+		auto b = twice.interpolate(0u, x);
+		if (a != b)
+		{
+			std::cerr << "ERROR: Interpolation at " << x.transpose() << " differs: " << a << " vs. " << b << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include <Discregrid/All>
+#include <Eigen/Dense>
+
+#include <iostream>
+#include <limits>
+
+using namespace Eigen;
+
+// After reducing a sparse field, the cells discarded within kept bricks must be undefined for both
+// the direct interpolation and the interpolation through precomputed shape functions.
+
+int main()
+{
+	auto domain = AlignedBox3f(Vector3f::Constant(-1.0f), Vector3f::Constant(1.0f));
+	auto sphere = [](Vector3f const& x) { return x.norm() - 0.5f; };
+	auto narrow = [](Vector3f const&, float v) { return std::abs(v) < 0.1f; };
+
+	Discregrid::SparseCubicLagrangeDiscreteGrid grid(domain, {{32, 32, 32}});
+	grid.addFunction(sphere);
+	grid.reduceField(0u, narrow);
+
+	auto n_defined = 0u, n_undefined = 0u;
+	for (auto i = 0u; i < 10000u; ++i)
+	{
+		auto x = Vector3f::Random().eval();
+		auto gradient = Vector3f{};
+		auto a = grid.interpolate(0u, x, &gradient);
+
+		auto cell = std::array<unsigned int, 32>{};
+		auto c0 = Vector3f{};
+		auto N = Matrix<float, 32, 1>{};
+		auto dN = Matrix<float, 32, 3>{};
+		auto shape_gradient = Vector3f{};
+		auto b = std::numeric_limits<float>::max();
+		if (grid.determineShapeFunctions(0u, x, cell, c0, N, &dN))
+			b = grid.interpolate(0u, x, cell, c0, N, &shape_gradient, &dN);
+
+		if (a != b || (a != std::numeric_limits<float>::max() && gradient != shape_gradient))
+		{
+			std::cerr << "ERROR: Interpolation at " << x.transpose() << " differs: " << a << " vs. " << b << std::endl;
+			return 1;
+		}
+		if (a == std::numeric_limits<float>::max())
+			++n_undefined;
+		else
+			++n_defined;
+	}
+
+	if (n_defined == 0u || n_undefined == 0u)
+	{
+		std::cerr << "ERROR: The reduced field is expected to be partially defined." << std::endl;
+		return 1;
+	}
+	return 0;
+}